@@ -0,0 +1,74 @@
+#include "BufferedWriter.h"
+
+#include <charconv>
+#include <string.h>
+
+// longest number written by Write()
+static const size_t MAX_NUMBER_LENGTH = 64;
+
+bool BufferedWriter::Open(const std::string& filename) {
+	file_.open(filename, std::ios::binary | std::ios::trunc);
+	used_ = 0;
+	bOk_ = file_.is_open();
+	return bOk_;
+}
+
+bool BufferedWriter::Close() {
+	if (!file_.is_open()) return false;
+
+	Flush();
+	file_.close();
+	if (file_.fail()) bOk_ = false;
+	return bOk_;
+}
+
+void BufferedWriter::Flush() {
+	if (used_ == 0) return;
+
+	file_.write(buffer_.data(), used_);
+	bOk_ = bOk_ && file_.good();
+	used_ = 0;
+}
+
+// room for size more characters, flushing first if needed
+char* BufferedWriter::Reserve(size_t size) {
+	if (used_ + size > buffer_.size()) Flush();
+	return buffer_.data() + used_;
+}
+
+BufferedWriter& BufferedWriter::Write(std::string_view text) {
+	if (text.size() > buffer_.size()) {
+		Flush();
+		file_.write(text.data(), text.size());
+		bOk_ = bOk_ && file_.good();
+		return *this;
+	}
+
+	memcpy(Reserve(text.size()), text.data(), text.size());
+	used_ += text.size();
+	return *this;
+}
+
+BufferedWriter& BufferedWriter::Write(char c) {
+	*Reserve(1) = c;
+	used_++;
+	return *this;
+}
+
+BufferedWriter& BufferedWriter::Write(int value) {
+	char* begin = Reserve(MAX_NUMBER_LENGTH);
+	used_ = std::to_chars(begin, begin + MAX_NUMBER_LENGTH, value).ptr - buffer_.data();
+	return *this;
+}
+
+BufferedWriter& BufferedWriter::Write(float value, int precision) {
+	char* begin = Reserve(MAX_NUMBER_LENGTH);
+	auto result = std::to_chars(begin, begin + MAX_NUMBER_LENGTH, value, std::chars_format::fixed, precision);
+	if (result.ec == std::errc()) {
+		used_ = result.ptr - buffer_.data();
+	}
+	else {
+		bOk_ = false;
+	}
+	return *this;
+}
@@ -0,0 +1,39 @@
+#pragma once
+
+#include <fstream>
+#include <string>
+#include <string_view>
+#include <vector>
+
+/*
+	Writes text to a file through a fixed buffer, formatting numbers with std::to_chars instead of streams.
+*/
+class BufferedWriter
+{
+private:
+	std::ofstream file_{};
+	std::vector<char> buffer_{};
+	size_t used_ = 0;
+	bool bOk_ = false;
+
+	char* Reserve(size_t size);
+
+public:
+	static const size_t BUFFER_SIZE = 1 << 16;
+
+	// the buffer is there before Open(), so writing to a writer that failed to open is harmless
+	BufferedWriter() : buffer_(BUFFER_SIZE) {}
+
+	bool Open(const std::string& filename);
+	bool Close();
+	void Flush();
+
+	BufferedWriter& Write(std::string_view text);
+	BufferedWriter& Write(char c);
+	BufferedWriter& Write(int value);
+
+	// fixed notation with the given number of decimals; a value that can't be formatted fails the writer
+	BufferedWriter& Write(float value, int precision);
+
+	bool IsOk() const { return bOk_; }
+};
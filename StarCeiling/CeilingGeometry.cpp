@@ -0,0 +1,126 @@
+#include "CeilingGeometry.h"
+
+#include <algorithm>
+#include <math.h>
+#include <charconv>
+#include <fstream>
+#include <iostream>
+#include <sstream>
+#include <string_view>
+
+// smallest room and panel accepted, in mm
+static const float MIN_SIZE_MM = 100.f;
+static const float MIN_PANEL_MM = 50.f;
+
+CeilingGeometry::CeilingGeometry(Vector2<float> size_mm, Vector2<float> panel_mm, float north_degrees)
+	: size_mm_{ std::max(size_mm.x, MIN_SIZE_MM), std::max(size_mm.y, MIN_SIZE_MM) },
+	panel_mm_{ std::max(panel_mm.x, MIN_PANEL_MM), std::max(panel_mm.y, MIN_PANEL_MM) } {
+	// a sliver narrower than a millimetre isn't worth a panel
+	panels_.x = std::max(static_cast<int>(ceilf(size_mm_.x / panel_mm_.x - 1e-3f)), 1);
+	panels_.y = std::max(static_cast<int>(ceilf(size_mm_.y / panel_mm_.y - 1e-3f)), 1);
+
+	north_ = static_cast<float>(fmod(north_degrees, 360.0) * M_PI / 180.0);
+	north_rotation_ = Vector2<float>(cosf(north_), sinf(north_));
+}
+
+// parses "<x>x<y>" covering the whole of text
+static bool parsePair(std::string_view text, Vector2<float>& pair) {
+	const size_t separator = text.find('x');
+	if (separator == std::string_view::npos) return false;
+
+	const char* end = text.data() + text.size();
+	auto x = std::from_chars(text.data(), text.data() + separator, pair.x);
+	auto y = std::from_chars(text.data() + separator + 1, end, pair.y);
+	return x.ec == std::errc() && x.ptr == text.data() + separator && y.ec == std::errc() && y.ptr == end;
+}
+
+bool CeilingGeometry::Parse(const std::string& description, CeilingGeometry& geometry) {
+	Vector2<float> size = geometry.size_mm_;
+	Vector2<float> panel = geometry.panel_mm_;
+	float north = static_cast<float>(geometry.north_ * 180.0 / M_PI);
+
+	std::string_view text = description;
+	const size_t at = text.find('@');
+	if (at != std::string_view::npos) {
+		auto result = std::from_chars(text.data() + at + 1, text.data() + text.size(), north);
+		if (result.ec != std::errc() || result.ptr != text.data() + text.size()) return false;
+		text = text.substr(0, at);
+	}
+
+	const size_t slash = text.find('/');
+	if (slash != std::string_view::npos) {
+		if (!parsePair(text.substr(slash + 1), panel)) return false;
+		text = text.substr(0, slash);
+	}
+
+	if (!text.empty() && !parsePair(text, size)) return false;
+	if (size.x <= 0.f || size.y <= 0.f || panel.x <= 0.f || panel.y <= 0.f) return false;
+
+	CeilingGeometry parsed(size, panel, north);
+	parsed.outline_ = std::move(geometry.outline_);
+	geometry = std::move(parsed);
+	return true;
+}
+
+bool CeilingGeometry::LoadOutline(const std::string& filename) {
+	std::ifstream file(filename);
+	if (!file.is_open()) {
+		std::cout << "Failed to open ceiling outline " << filename << "\n";
+		return false;
+	}
+
+	std::vector<std::vector<Vector2<float>>> rings;
+	std::string line;
+	int line_number = 0;
+	while (std::getline(file, line)) {
+		line_number++;
+		if (line.empty() || line[0] == '#' || line.find_first_not_of(" \t\r") == std::string::npos) continue;
+
+		std::vector<Vector2<float>> ring;
+		std::istringstream points(line);
+		std::string point;
+		while (points >> point) {
+			Vector2<float> vertex(0.f, 0.f);
+			const size_t comma = point.find(',');
+			if (comma == std::string::npos) break;
+			point[comma] = 'x';
+			if (!parsePair(point, vertex)) break;
+			ring.push_back(vertex);
+		}
+
+		if (ring.size() < 3 || !points.eof()) {
+			std::cout << "Invalid ring on line " << line_number << " of " << filename << "\n";
+			return false;
+		}
+		rings.push_back(std::move(ring));
+	}
+
+	outline_ = std::move(rings);
+	return true;
+}
+
+int CeilingGeometry::GetPanelIndex(Vector2<float> mm) const {
+	const int column = std::clamp(static_cast<int>(floorf(mm.x / panel_mm_.x)), 0, panels_.x - 1);
+	const int row = std::clamp(static_cast<int>(floorf(mm.y / panel_mm_.y)), 0, panels_.y - 1);
+	return row * panels_.x + column;
+}
+
+Vector2<float> CeilingGeometry::GetPanelOrigin(int index) const {
+	return Vector2<float>(panel_mm_.x * (index % panels_.x), panel_mm_.y * (index / panels_.x));
+}
+
+Vector2<float> CeilingGeometry::GetPanelSize(int index) const {
+	const Vector2<float> origin = GetPanelOrigin(index);
+	return Vector2<float>(
+		std::min(panel_mm_.x, size_mm_.x - origin.x),
+		std::min(panel_mm_.y, size_mm_.y - origin.y));
+}
+
+bool CeilingGeometry::operator==(const CeilingGeometry& other) const {
+	return size_mm_.x == other.size_mm_.x && size_mm_.y == other.size_mm_.y
+		&& panel_mm_.x == other.panel_mm_.x && panel_mm_.y == other.panel_mm_.y
+		&& north_ == other.north_ && outline_.size() == other.outline_.size()
+		&& std::equal(outline_.begin(), outline_.end(), other.outline_.begin(), [](const auto& a, const auto& b) {
+			return std::equal(a.begin(), a.end(), b.begin(), b.end(), [](Vector2<float> p, Vector2<float> q) { return p.x == q.x && p.y == q.y; });
+		});
+}
@@ -0,0 +1,66 @@
+#pragma once
+
+#include <string>
+#include <vector>
+#include "types.h"
+
+/*
+	Physical layout of the ceiling: its size, the grid of panels covering it and the direction of north.
+	Panels are laid from the top left corner; the last column and row are trimmed to the ceiling, so any
+	room size works with any panel size. All lengths are in mm, with Y pointing down the screen.
+	An optional outline limits the ceiling to a polygon with holes, for L-shaped rooms, bulkheads, light
+	fittings and vents. Its rings combine with the even-odd rule.
+*/
+class CeilingGeometry
+{
+private:
+	Vector2<float> size_mm_{ 3000.f, 2500.f };
+	Vector2<float> panel_mm_{ 500.f, 500.f };
+	Vector2<int> panels_{ 6, 5 };
+	float north_ = 0.f;						// radians clockwise from the top edge
+	Vector2<float> north_rotation_{ 1.f, 0.f };	// cos, sin
+	std::vector<std::vector<Vector2<float>>> outline_{};	// closed rings, empty for the whole rectangle
+
+public:
+	CeilingGeometry() = default;
+	CeilingGeometry(Vector2<float> size_mm, Vector2<float> panel_mm, float north_degrees);
+
+	/*
+		Parses "<width>x<length>[/<panel width>x<panel length>][@<north degrees>]", e.g. "3600x2400/600x600@90".
+		Returns false and leaves geometry unchanged if the description isn't valid.
+	*/
+	static bool Parse(const std::string& description, CeilingGeometry& geometry);
+
+	/*
+		Reads the outline from a text file with one ring per line as "x,y x,y x,y ...", the room's outline
+		first, then any cut outs. Blank lines and lines starting with # are skipped.
+	*/
+	bool LoadOutline(const std::string& filename);
+	void SetOutline(std::vector<std::vector<Vector2<float>>> rings) { outline_ = std::move(rings); }
+	const std::vector<std::vector<Vector2<float>>>& GetOutline() const { return outline_; }
+	bool HasOutline() const { return !outline_.empty(); }
+
+	Vector2<float> GetSizeMM() const { return size_mm_; }
+	Vector2<float> GetPanelSizeMM() const { return panel_mm_; }
+	Vector2<int> GetPanelCount() const { return panels_; }
+	int GetNumPanels() const { return panels_.x * panels_.y; }
+	float GetAspect() const { return size_mm_.x / size_mm_.y; }
+	float GetNorth() const { return north_; }
+
+	// index of the panel containing the point, row by row; points off the ceiling use the nearest panel
+	int GetPanelIndex(Vector2<float> mm) const;
+
+	// top left corner and size of a panel, edge panels are trimmed
+	Vector2<float> GetPanelOrigin(int index) const;
+	Vector2<float> GetPanelSize(int index) const;
+
+	// turns normalized sky coordinates (north up) to the ceiling's orientation
+	Vector2<float> Orient(Vector2<float> coords_n) const {
+		return Vector2<float>(
+			coords_n.x * north_rotation_.x - coords_n.y * north_rotation_.y,
+			coords_n.x * north_rotation_.y + coords_n.y * north_rotation_.x);
+	}
+
+	bool operator==(const CeilingGeometry& other) const;
+	bool operator!=(const CeilingGeometry& other) const { return !(*this == other); }
+};
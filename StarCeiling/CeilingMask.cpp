@@ -0,0 +1,58 @@
+#include "CeilingMask.h"
+#include "CeilingGeometry.h"
+
+#include <algorithm>
+#include <math.h>
+
+void CeilingMask::FillSpan(int y, int x_start, int x_end) {
+	x_start = std::max(x_start, 0);
+	x_end = std::min(x_end, size_.x);
+	uint64_t* row = bits_.data() + static_cast<size_t>(y) * words_per_row_;
+	for (int x = x_start; x < x_end;) {
+		const int bit = x & 63;
+		const int count = std::min(64 - bit, x_end - x);
+		const uint64_t span = count == 64 ? ~0ull : ((1ull << count) - 1) << bit;
+		row[x >> 6] |= span;
+		x += count;
+	}
+}
+
+/*
+	Scanline fill: each row's crossings with the edges of all rings are sorted together, and the pixels whose
+	centres lie between alternate pairs are covered, which gives the even-odd rule.
+*/
+void CeilingMask::Build(const CeilingGeometry& geometry, Vector2<int> size) {
+	size_ = size;
+	bRectangular_ = !geometry.HasOutline() || size.x <= 0 || size.y <= 0;
+	if (bRectangular_) {
+		bits_.clear();
+		words_per_row_ = 0;
+		return;
+	}
+
+	words_per_row_ = (size.x + 63) / 64;
+	bits_.assign(static_cast<size_t>(words_per_row_) * size.y, 0);
+
+	const float px_per_mm = size.x / geometry.GetSizeMM().x;
+	std::vector<float> crossings;
+	for (int y = 0; y < size.y; y++) {
+		const float y_mm = (y + 0.5f) / px_per_mm;
+
+		crossings.clear();
+		for (const auto& ring : geometry.GetOutline()) {
+			for (size_t i = 0; i < ring.size(); i++) {
+				const Vector2<float>& a = ring[i];
+				const Vector2<float>& b = ring[(i + 1) % ring.size()];
+				if ((a.y <= y_mm) == (b.y <= y_mm)) continue;
+
+				const float x_mm = a.x + (y_mm - a.y) * (b.x - a.x) / (b.y - a.y);
+				crossings.push_back(x_mm * px_per_mm);
+			}
+		}
+		std::sort(crossings.begin(), crossings.end());
+
+		for (size_t i = 0; i + 1 < crossings.size(); i += 2) {
+			FillSpan(y, static_cast<int>(ceilf(crossings[i] - 0.5f)), static_cast<int>(ceilf(crossings[i + 1] - 0.5f)));
+		}
+	}
+}
@@ -0,0 +1,35 @@
+#pragma once
+
+#include <stdint.h>
+#include <vector>
+#include "types.h"
+
+class CeilingGeometry;
+
+/*
+	Which pixels of the ceiling on screen are part of the ceiling, rasterized from the geometry's outline
+	once per layout into one bit per pixel. Without an outline every pixel is covered and no mask is kept.
+*/
+class CeilingMask
+{
+private:
+	std::vector<uint64_t> bits_{};
+	Vector2<int> size_{ 0, 0 };
+	int words_per_row_ = 0;
+	bool bRectangular_ = true;
+
+	void FillSpan(int y, int x_start, int x_end);
+
+public:
+	// Rasterizes the outline at the pixel centres of a ceiling size pixels large
+	void Build(const CeilingGeometry& geometry, Vector2<int> size);
+
+	bool IsRectangular() const { return bRectangular_; }
+
+	// true if the ceiling pixel is covered, pixels outside the ceiling rectangle aren't
+	bool Contains(int x, int y) const {
+		if (x < 0 || y < 0 || x >= size_.x || y >= size_.y) return false;
+		if (bRectangular_) return true;
+		return (bits_[static_cast<size_t>(y) * words_per_row_ + (x >> 6)] >> (x & 63)) & 1;
+	}
+};
@@ -0,0 +1,268 @@
+#include "DrillPath.h"
+#include "SpatialGrid.h"
+
+#include <algorithm>
+#include <math.h>
+
+// candidate moves per hole
+static const int NUM_NEIGHBOURS = 8;
+
+// ignore improvements smaller than this, in mm
+static const float MIN_IMPROVEMENT = 1e-4f;
+
+static float distance(Vector2<float> a, Vector2<float> b) {
+	return hypotf(a.x - b.x, a.y - b.y);
+}
+
+namespace {
+	/*
+		An open tour from a fixed start point. Tour positions are 0..n-1; position -1 is the start and
+		position n is "no next hole", which costs nothing to reach.
+	*/
+	class Tour {
+	private:
+		const std::vector<Vector2<float>>& holes_;
+		Vector2<float> start_;
+		std::vector<int> order_;
+		std::vector<int> position_;
+
+	public:
+		Tour(const std::vector<Vector2<float>>& holes, Vector2<float> start, std::vector<int> order)
+			: holes_{ holes }, start_{ start }, order_{ std::move(order) }, position_(holes.size()) {
+			UpdatePositions(0, static_cast<int>(order_.size()) - 1);
+		}
+
+		int Size() const { return static_cast<int>(order_.size()); }
+		int GetHole(int position) const { return order_[position]; }
+		int GetPosition(int hole) const { return position_[hole]; }
+		const std::vector<int>& GetOrder() const { return order_; }
+
+		bool HasPoint(int position) const { return position >= -1 && position < Size(); }
+		Vector2<float> GetPoint(int position) const { return position < 0 ? start_ : holes_[order_[position]]; }
+
+		// length of the edge between two tour positions, edges to the end are free
+		float Cost(int from, int to) const {
+			if (!HasPoint(from) || !HasPoint(to)) return 0.f;
+			return distance(GetPoint(from), GetPoint(to));
+		}
+
+		void UpdatePositions(int first, int last) {
+			for (int i = first; i <= last; i++) position_[order_[i]] = i;
+		}
+
+		// change in length from reversing positions first..last
+		float ReverseDelta(int first, int last) const {
+			return Cost(first - 1, last) + Cost(first, last + 1) - Cost(first - 1, first) - Cost(last, last + 1);
+		}
+
+		void Reverse(int first, int last) {
+			std::reverse(order_.begin() + first, order_.begin() + last + 1);
+			UpdatePositions(first, last);
+		}
+
+		/*
+			Moves the holes at first..first+length-1 to between positions after and after+1 (after may be
+			-1 for the start), optionally reversed.
+		*/
+		void Move(int first, int length, int after, bool bReversed) {
+			std::vector<int> moved(order_.begin() + first, order_.begin() + first + length);
+			if (bReversed) std::reverse(moved.begin(), moved.end());
+
+			order_.erase(order_.begin() + first, order_.begin() + first + length);
+			const int insert_at = after < first ? after + 1 : after + 1 - length;
+			order_.insert(order_.begin() + insert_at, moved.begin(), moved.end());
+			UpdatePositions(std::min(first, insert_at), std::max(first + length, insert_at + length) - 1);
+		}
+	};
+}
+
+// a grid over the holes with cells holding a few holes each; returns the extent of the holes
+static float buildHoleGrid(const std::vector<Vector2<float>>& holes, SpatialGrid& grid) {
+	float min_x = holes[0].x, max_x = holes[0].x, min_y = holes[0].y, max_y = holes[0].y;
+	for (const auto& hole : holes) {
+		min_x = std::min(min_x, hole.x);
+		max_x = std::max(max_x, hole.x);
+		min_y = std::min(min_y, hole.y);
+		max_y = std::max(max_y, hole.y);
+	}
+	const float extent = std::max(max_x - min_x, max_y - min_y) + 1.f;
+	const float cell_size = std::max(extent * sqrtf(4.f / holes.size()), 1e-3f);
+
+	grid.Reset(cell_size, holes.size());
+	for (int i = 0; i < static_cast<int>(holes.size()); i++) grid.Insert(i, holes[i]);
+	return extent;
+}
+
+static std::vector<std::vector<int>> findNeighbours(const std::vector<Vector2<float>>& holes, const SpatialGrid& grid, float extent) {
+	const int n = static_cast<int>(holes.size());
+	std::vector<std::vector<int>> neighbours(n);
+	if (n < 2) return neighbours;
+
+	const int wanted = std::min(NUM_NEIGHBOURS, n - 1);
+	std::vector<std::pair<float, int>> candidates;
+	for (int i = 0; i < n; i++) {
+		// widen the search until there are enough candidates
+		for (float radius = grid.GetCellSize(); ; radius *= 2.f) {
+			candidates.clear();
+			grid.ForEachNear(holes[i], radius, [&](int id, Vector2<float> position) {
+				if (id != i) candidates.push_back({ distance(holes[i], position), id });
+			});
+			if (static_cast<int>(candidates.size()) >= wanted || radius > extent * 2.f) break;
+		}
+
+		const int count = std::min(wanted, static_cast<int>(candidates.size()));
+		std::partial_sort(candidates.begin(), candidates.begin() + count, candidates.end());
+		for (int k = 0; k < count; k++) neighbours[i].push_back(candidates[k].second);
+	}
+
+	return neighbours;
+}
+
+/*
+	Greedy tour: the nearest unvisited hole is found in a widening search of the grid. Any hole found
+	within the search radius is nearer than all holes outside it, so the first radius that finds one is
+	enough. Ties go to the lower index.
+*/
+static std::vector<int> nearestNeighbourTour(const std::vector<Vector2<float>>& holes, Vector2<float> start, const SpatialGrid& grid, float extent) {
+	const int n = static_cast<int>(holes.size());
+	std::vector<int> order;
+	order.reserve(n);
+	std::vector<char> visited(n, 0);
+
+	// the start may lie outside the holes' extent
+	float max_radius = extent;
+	for (const auto& hole : holes) max_radius = std::max(max_radius, distance(start, hole));
+
+	Vector2<float> current = start;
+	for (int step = 0; step < n; step++) {
+		int best = -1;
+		float best_distance = 0.f;
+		for (float radius = grid.GetCellSize(); best < 0 && radius <= max_radius * 2.f; radius *= 2.f) {
+			grid.ForEachNear(current, radius, [&](int id, Vector2<float> position) {
+				if (visited[id]) return;
+
+				const float d = distance(current, position);
+				if (best < 0 || d < best_distance || (d == best_distance && id < best)) {
+					best = id;
+					best_distance = d;
+				}
+			});
+		}
+
+		visited[best] = 1;
+		order.push_back(best);
+		current = holes[best];
+	}
+
+	return order;
+}
+
+static bool improveTwoOpt(Tour& tour, const std::vector<std::vector<int>>& neighbours) {
+	bool bImproved = false;
+	const int n = tour.Size();
+
+	for (int i = 0; i < n; i++) {
+		const int a = tour.GetHole(i);
+		for (int c : neighbours[a]) {
+			// make a and c adjacent by reversing the holes between them
+			const int j = tour.GetPosition(c);
+			const int first = j > i ? i + 1 : j + 1;
+			const int last = j > i ? j : i;
+			if (last <= first) continue;
+
+			if (tour.ReverseDelta(first, last) < -MIN_IMPROVEMENT) {
+				tour.Reverse(first, last);
+				bImproved = true;
+				break;
+			}
+		}
+
+		// start the tour at a different hole
+		if (tour.ReverseDelta(0, i) < -MIN_IMPROVEMENT) {
+			tour.Reverse(0, i);
+			bImproved = true;
+		}
+	}
+
+	return bImproved;
+}
+
+static bool improveOrOpt(Tour& tour, const std::vector<std::vector<int>>& neighbours) {
+	bool bImproved = false;
+	const int n = tour.Size();
+
+	for (int length = 1; length <= 3; length++) {
+		for (int first = 0; first + length <= n; first++) {
+			const int last = first + length - 1;
+			const float removed = tour.Cost(first - 1, first) + tour.Cost(last, last + 1) - tour.Cost(first - 1, last + 1);
+
+			// insert next to a neighbour of either end, on either side of it
+			float best_delta = -MIN_IMPROVEMENT;
+			int best_after = 0;
+			bool bBestReversed = false;
+			bool bFound = false;
+			for (int end : { tour.GetHole(first), tour.GetHole(last) }) {
+				for (int c : neighbours[end]) {
+					const int j = tour.GetPosition(c);
+					for (int after : { j - 1, j }) {
+						if (after >= first - 1 && after <= last) continue;
+
+						const float gap = tour.Cost(after, after + 1);
+						const Vector2<float> left = tour.GetPoint(after);
+						const bool bHasRight = tour.HasPoint(after + 1);
+						const Vector2<float> right = bHasRight ? tour.GetPoint(after + 1) : left;
+						const Vector2<float> head = tour.GetPoint(first);
+						const Vector2<float> tail = tour.GetPoint(last);
+
+						const float forward = distance(left, head) + (bHasRight ? distance(tail, right) : 0.f) - gap;
+						const float backward = distance(left, tail) + (bHasRight ? distance(head, right) : 0.f) - gap;
+						const float delta = std::min(forward, backward) - removed;
+						if (delta < best_delta) {
+							best_delta = delta;
+							best_after = after;
+							bBestReversed = backward < forward;
+							bFound = true;
+						}
+					}
+				}
+			}
+
+			if (bFound) {
+				tour.Move(first, length, best_after, bBestReversed);
+				bImproved = true;
+			}
+		}
+	}
+
+	return bImproved;
+}
+
+std::vector<int> planDrillPath(const std::vector<Vector2<float>>& holes, Vector2<float> start, int max_passes) {
+	if (holes.empty()) return {};
+
+	SpatialGrid grid;
+	const float extent = buildHoleGrid(holes, grid);
+	std::vector<int> order = nearestNeighbourTour(holes, start, grid, extent);
+	if (holes.size() < 3) return order;
+
+	const auto neighbours = findNeighbours(holes, grid, extent);
+	Tour tour(holes, start, std::move(order));
+
+	bool bImproved = true;
+	for (int pass = 0; bImproved && pass < max_passes; pass++) {
+		bImproved = improveTwoOpt(tour, neighbours);
+		bImproved = improveOrOpt(tour, neighbours) || bImproved;
+	}
+
+	return tour.GetOrder();
+}
+
+float getDrillPathLength(const std::vector<Vector2<float>>& holes, const std::vector<int>& order, Vector2<float> start) {
+	float length = 0.f;
+	Vector2<float> current = start;
+	for (int hole : order) {
+		length += distance(current, holes[hole]);
+		current = holes[hole];
+	}
+	return length;
+}
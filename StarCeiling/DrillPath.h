@@ -0,0 +1,14 @@
+#pragma once
+
+#include <vector>
+#include "types.h"
+
+/*
+	Orders drill holes for a short tool path starting at start: a nearest neighbour tour improved by 2-opt
+	and Or-opt moves, trying only each hole's nearest neighbours. Stops improving after max_passes passes,
+	so the same holes always give the same order. Returns the hole indices in drilling order.
+*/
+std::vector<int> planDrillPath(const std::vector<Vector2<float>>& holes, Vector2<float> start, int max_passes);
+
+// travel from start through the holes in the given order
+float getDrillPathLength(const std::vector<Vector2<float>>& holes, const std::vector<int>& order, Vector2<float> start);
@@ -0,0 +1,628 @@
+#include <math.h>
+#include <algorithm>
+#include <chrono>
+#include <filesystem>
+#include <future>
+#include <iostream>
+#include <memory>
+#include <numeric>
+#include <unordered_map>
+#include <vector>
+
+#include "Export.h"
+#include "globals.h"
+#include "graphics.h"
+#include "utilities.h"
+#include "PngWriter.h"
+#include "BufferedWriter.h"
+#include "DrillPath.h"
+#include "FiberBundles.h"
+#include "Rasterizer.h"
+#include "ThreadPool.h"
+
+namespace {
+	// everything drawn into the print, in print pixels
+	struct PrintStar {
+		Vector2<float> position;
+		float radius;
+		RGB colour;
+		uint8_t brightness;
+	};
+
+	struct PrintLabel {
+		Vector2<int> position;
+		SDL_Surface* surface; // RGBA32
+	};
+
+	struct PrintLayout {
+		Vector2<int> size{ 0, 0 };
+		std::vector<PrintStar> stars{};
+		std::vector<std::pair<Vector2<float>, Vector2<float>>> lines{};
+		std::vector<SDL_Rect> grid{};
+		std::vector<PrintLabel> labels{};
+
+		~PrintLayout() {
+			for (auto& label : labels) SDL_FreeSurface(label.surface);
+		}
+	};
+}
+
+static float getHoleDiameter(StarSize size) {
+	switch (size) {
+	case StarSize::LARGE:
+		return star_hole_diameter_large;
+	case StarSize::MEDIUM:
+		return star_hole_diameter_medium;
+	default:
+		return star_hole_diameter_small;
+	}
+}
+
+/*
+	Renders segment IDs once up front; the fonts can't be used from the tile threads.
+*/
+static void createLabels(PrintLayout& layout, float px_per_mm) {
+	const int label_px = static_cast<int>(EXPORT_LABEL_HEIGHT_MM * px_per_mm);
+	TTF_Font* font = TTF_OpenFont((Environment::fontname + ".ttf").c_str(), label_px);
+	if (!font) {
+		std::cout << "Failed to load label font: " << TTF_GetError() << "\n";
+		return;
+	}
+
+	const SDL_Color foreground = { 128, 128, 200, SDL_ALPHA_OPAQUE };
+	const int padding = label_px / 4;
+	for (const auto& segment : segments) {
+		SDL_Surface* text_surf = TTF_RenderText_Blended(font, std::to_string(segment.GetID()).c_str(), foreground);
+		if (!text_surf) continue;
+
+		SDL_Surface* rgba = SDL_ConvertSurfaceFormat(text_surf, SDL_PIXELFORMAT_RGBA32, 0);
+		SDL_FreeSurface(text_surf);
+		if (!rgba) continue;
+
+		const Vector2<float> origin = segment.GetOriginMM() * px_per_mm;
+		layout.labels.push_back(PrintLabel{
+			Vector2<int>(static_cast<int>(origin.x) + padding, static_cast<int>(origin.y) + padding),
+			rgba
+		});
+	}
+
+	TTF_CloseFont(font);
+}
+
+/*
+	Scales the current selection and view from window pixels up to the print. The ceiling on screen maps
+	to the physical ceiling of ceiling_geometry at export_dpi.
+*/
+static void createLayout(PrintLayout& layout) {
+	const float px_per_mm = export_dpi / MM_PER_INCH;
+	const Vector2<float> ceiling_mm = ceiling_geometry.GetSizeMM();
+	layout.size = Vector2<int>(static_cast<int>(lroundf(ceiling_mm.x * px_per_mm)), static_cast<int>(lroundf(ceiling_mm.y * px_per_mm)));
+	const float k = layout.size.x / static_cast<float>(ceiling_size.x);
+
+	for (const auto& star : selected_stars) {
+		const Vector2<float> ceiling_coords = star.position - star_layer_margin;
+		layout.stars.push_back(PrintStar{
+			ceiling_coords * k,
+			getHoleDiameter(star.size) * px_per_mm / 2.f,
+			star.colour,
+			star.brightness
+		});
+	}
+
+	Polylines lines;
+	getConstellationLines(lines);
+	int start = 0;
+	for (int end : lines.ends) {
+		for (int i = start + 1; i < end; i++) {
+			layout.lines.push_back({ lines.points[i - 1] * k, lines.points[i] * k });
+		}
+		start = end;
+	}
+
+	// segment grid including the border
+	const int line_width = std::max(1, static_cast<int>(lroundf(EXPORT_GRID_WIDTH_MM * px_per_mm)));
+	const Vector2<float> panel_px = ceiling_geometry.GetPanelSizeMM() * px_per_mm;
+	const Vector2<int> panels = ceiling_geometry.GetPanelCount();
+	for (int x = 0; x <= panels.x; x++) {
+		const float edge = x < panels.x ? x * panel_px.x : static_cast<float>(layout.size.x);
+		const int left = std::clamp(static_cast<int>(lroundf(edge)) - line_width / 2, 0, layout.size.x - line_width);
+		layout.grid.push_back(SDL_Rect{ left, 0, line_width, layout.size.y });
+	}
+	for (int y = 0; y <= panels.y; y++) {
+		const float edge = y < panels.y ? y * panel_px.y : static_cast<float>(layout.size.y);
+		const int top = std::clamp(static_cast<int>(lroundf(edge)) - line_width / 2, 0, layout.size.y - line_width);
+		layout.grid.push_back(SDL_Rect{ 0, top, layout.size.x, line_width });
+	}
+
+	if (bExportLabels) {
+		createLabels(layout, px_per_mm);
+	}
+}
+
+/*
+	Draws the part of the layout inside tile into the rows of strip, which start at the tile's top edge.
+*/
+static void renderTile(const PrintLayout& layout, const SDL_Rect& tile, uint8_t* strip, int pitch) {
+	Rasterizer rasterizer;
+	rasterizer.Resize(tile.w, tile.h);
+	const Vector2<float> origin(static_cast<float>(tile.x), static_cast<float>(tile.y));
+
+	for (const auto& star : layout.stars) {
+		// the splat fades out within three radii
+		const float extent = star.radius * 3.f + 1.f;
+		if (star.position.x + extent < tile.x || star.position.x - extent > tile.x + tile.w
+			|| star.position.y + extent < tile.y || star.position.y - extent > tile.y + tile.h) continue;
+
+		rasterizer.AddStar(star.position - origin, star.radius, star.colour, star.brightness);
+	}
+	rasterizer.Rasterize(nullptr);
+
+	const Vector2<float> clip_min(-1.f, -1.f);
+	const Vector2<float> clip_max(tile.w + 1.f, tile.h + 1.f);
+	for (const auto& line : layout.lines) {
+		Vector2<float> start = line.first - origin;
+		Vector2<float> end = line.second - origin;
+		if (clipLine(start, end, clip_min, clip_max)) {
+			rasterizer.AddLine(start, end, RGBA{ constellation_colour.R, constellation_colour.G, constellation_colour.B, 35 });
+		}
+	}
+
+	for (const auto& rect : layout.grid) {
+		SDL_Rect overlap;
+		if (SDL_IntersectRect(&rect, &tile, &overlap)) {
+			rasterizer.AddRect(overlap.x - tile.x, overlap.y - tile.y, overlap.w, overlap.h, RGBA{ grid_colour.R, grid_colour.G, grid_colour.B, SDL_ALPHA_OPAQUE });
+		}
+	}
+
+	for (const auto& label : layout.labels) {
+		const SDL_Rect bounds = SDL_Rect{ label.position.x, label.position.y, label.surface->w, label.surface->h };
+		if (SDL_HasIntersection(&bounds, &tile)) {
+			rasterizer.AddImage(label.position.x - tile.x, label.position.y - tile.y, label.surface->w, label.surface->h,
+				static_cast<const uint8_t*>(label.surface->pixels), label.surface->pitch);
+		}
+	}
+
+	rasterizer.Resolve(strip + static_cast<size_t>(tile.x) * 4, pitch, nullptr);
+}
+
+// the print being written on the thread pool
+namespace PrintState {
+	static std::future<bool> job{};
+}
+
+/*
+	Writes the ceiling at 1:1 scale (export_dpi) to a PNG, for fabrication. The image is far too large for a
+	texture, so it is drawn in EXPORT_TILE_SIZE tiles: each row of tiles is rasterized in parallel into a
+	strip, which is compressed on a worker while the next strip is drawn. Memory stays at two strips of
+	8 bit pixels plus one float tile per thread, whatever the print size. Only reads the layout, so it can
+	run on a worker itself.
+*/
+static bool writePrint(const PrintLayout& layout, const std::string& filename) {
+
+	PngWriter png;
+	if (!png.Open(filename, layout.size.x, layout.size.y)) {
+		return false;
+	}
+
+	const int pitch = layout.size.x * 4;
+	const int tiles_x = (layout.size.x + EXPORT_TILE_SIZE - 1) / EXPORT_TILE_SIZE;
+	const int tiles_y = (layout.size.y + EXPORT_TILE_SIZE - 1) / EXPORT_TILE_SIZE;
+	std::vector<uint8_t> strips[2];
+	std::future<bool> writing;
+
+	auto write_strip = [&png, pitch](const std::vector<uint8_t>* strip, int rows) {
+		for (int row = 0; row < rows; row++) {
+			png.WriteRow(strip->data() + static_cast<size_t>(row) * pitch);
+		}
+		return png.IsOk();
+	};
+
+	bool bOk = true;
+	for (int tile_y = 0; tile_y < tiles_y && bOk; tile_y++) {
+		const int top = tile_y * EXPORT_TILE_SIZE;
+		const int rows = std::min(EXPORT_TILE_SIZE, layout.size.y - top);
+		std::vector<uint8_t>& strip = strips[tile_y % 2];
+		strip.resize(static_cast<size_t>(pitch) * rows);
+
+		auto render_tile = [&layout, &strip, pitch, top, rows](int tile_x) {
+			const int left = tile_x * EXPORT_TILE_SIZE;
+			const SDL_Rect tile = SDL_Rect{ left, top, std::min(EXPORT_TILE_SIZE, layout.size.x - left), rows };
+			renderTile(layout, tile, strip.data(), pitch);
+		};
+
+		if (thread_pool) {
+			thread_pool->ParallelFor(tiles_x, render_tile);
+		}
+		else {
+			for (int tile_x = 0; tile_x < tiles_x; tile_x++) render_tile(tile_x);
+		}
+
+		// the previous strip must be written before the next one is drawn over it
+		if (writing.valid()) bOk = writing.get();
+
+		// a single worker running this export couldn't also take the write
+		if (thread_pool && thread_pool->GetThreadCount() > 1) {
+			writing = thread_pool->Submit([&write_strip, &strip, rows] { return write_strip(&strip, rows); });
+		}
+		else {
+			bOk = bOk && write_strip(&strip, rows);
+		}
+
+		std::cout << "\rExporting: " << (tile_y + 1) * 100 / tiles_y << "%" << std::flush;
+	}
+	if (writing.valid()) bOk = writing.get() && bOk;
+	std::cout << "\n";
+
+	bOk = png.Close() && bOk;
+	std::cout << (bOk ? "Saved " : "Failed to save ") << filename << "\n";
+	return bOk;
+}
+
+// the print shows exactly what the current view would at full quality; the labels need the fonts, so this runs on the UI thread
+static std::shared_ptr<PrintLayout> createPrintLayout(const std::string& filename) {
+	selectStars(RenderQuality::FULL);
+	bStarsChanged = true;
+
+	auto layout = std::make_shared<PrintLayout>();
+	createLayout(*layout);
+	std::cout << "Exporting " << layout->size.x << " x " << layout->size.y << " px at " << export_dpi << " dpi to " << filename << "\n";
+	return layout;
+}
+
+bool exportPrint(const std::string& filename) {
+	if (bLoadingStars || ceiling_size.x <= 0) return false;
+
+	return writePrint(*createPrintLayout(filename), filename);
+}
+
+/*
+	Lays out the print on the UI thread and writes it on the thread pool, like GENERATE. Returns false if
+	a print is already being written.
+*/
+bool startExportPrint(const std::string& filename) {
+	if (bLoadingStars || ceiling_size.x <= 0 || isExportingPrint()) return false;
+	if (!thread_pool) return exportPrint(filename);
+
+	std::shared_ptr<const PrintLayout> layout = createPrintLayout(filename);
+	PrintState::job = thread_pool->Submit([layout, filename] { return writePrint(*layout, filename); });
+	return true;
+}
+
+bool isExportingPrint() {
+	return PrintState::job.valid();
+}
+
+// Call once per frame: collects the result once the print is written
+void updateExportPrint() {
+	if (PrintState::job.valid() && PrintState::job.wait_for(std::chrono::seconds(0)) == std::future_status::ready) {
+		PrintState::job.get();
+	}
+}
+
+void waitForExportPrint() {
+	if (PrintState::job.valid()) PrintState::job.get();
+}
+
+static const char* getSizeName(StarSize size) {
+	switch (size) {
+	case StarSize::LARGE:
+		return "large";
+	case StarSize::MEDIUM:
+		return "medium";
+	case StarSize::SMALL:
+		return "small";
+	default:
+		return "none";
+	}
+}
+
+// panel coordinates in mm: origin at the panel's bottom left corner, Y towards its top edge
+static Vector2<float> getHolePosition(const Segment& segment, const Segment::StarData& star) {
+	const Vector2<float> size = segment.GetSizeMM();
+	return Vector2<float>(star.screen_coords.x * size.x, (1.f - star.screen_coords.y) * size.y);
+}
+
+static bool writeHoleCSV(const Segment& segment, const std::string& filename) {
+	BufferedWriter out;
+	if (!out.Open(filename)) return false;
+
+	out.Write("star_id,x_mm,y_mm,diameter_mm,size\n");
+	for (const auto& star : segment.GetStars()) {
+		const Vector2<float> position = getHolePosition(segment, star);
+		out.Write(star.id).Write(',')
+			.Write(position.x, 3).Write(',')
+			.Write(position.y, 3).Write(',')
+			.Write(getHoleDiameter(star.star_size), 3).Write(',')
+			.Write(getSizeName(star.star_size)).Write('\n');
+	}
+
+	return out.Close();
+}
+
+namespace {
+	// tool travel between holes in mm, in magnitude order and optimized
+	struct DrillTravel {
+		float before = 0.f;
+		float after = 0.f;
+	};
+}
+
+/*
+	One G81 drill cycle per hole diameter, largest first, with a tool change (T1 = large) in between. Each
+	cycle visits its holes in an optimized order starting from the panel origin.
+*/
+static bool writeHoleGCode(const Segment& segment, const std::string& filename, DrillTravel& travel) {
+	BufferedWriter out;
+	if (!out.Open(filename)) return false;
+
+	out.Write("(StarCeiling segment ").Write(segment.GetID()).Write(")\n");
+	out.Write("G21 G90 G17\n");
+
+	const Vector2<float> origin(0.f, 0.f);
+	std::vector<Vector2<float>> holes;
+	static const StarSize tiers[3] = { StarSize::LARGE, StarSize::MEDIUM, StarSize::SMALL };
+	for (int tool = 1; tool <= 3; tool++) {
+		const StarSize size = tiers[tool - 1];
+		holes.clear();
+		for (const auto& star : segment.GetStars()) {
+			if (star.star_size == size) holes.push_back(getHolePosition(segment, star));
+		}
+		if (holes.empty()) continue;
+
+		const std::vector<int> order = planDrillPath(holes, origin, DRILL_PATH_MAX_PASSES);
+		std::vector<int> magnitude_order(holes.size());
+		std::iota(magnitude_order.begin(), magnitude_order.end(), 0);
+		travel.before += getDrillPathLength(holes, magnitude_order, origin);
+		travel.after += getDrillPathLength(holes, order, origin);
+
+		out.Write("(").Write(getHoleDiameter(size), 3).Write(" mm holes)\n");
+		out.Write("G0 Z").Write(DRILL_SAFE_Z_MM, 3).Write('\n');
+		out.Write('T').Write(tool).Write(" M6\n");
+		out.Write("G98 G81 R").Write(DRILL_RETRACT_MM, 3)
+			.Write(" Z").Write(-DRILL_DEPTH_MM, 3)
+			.Write(" F").Write(DRILL_FEED_RATE, 1);
+		for (int hole : order) {
+			out.Write(" X").Write(holes[hole].x, 3).Write(" Y").Write(holes[hole].y, 3).Write('\n');
+		}
+		out.Write("G80\n");
+	}
+
+	out.Write("G0 Z").Write(DRILL_SAFE_Z_MM, 3).Write('\n');
+	out.Write("M30\n");
+	return out.Close();
+}
+
+// ceiling coordinates in mm: origin at the bottom left corner of the ceiling, Y towards its top edge
+static Vector2<float> getCeilingHolePosition(const Segment& segment, const Segment::StarData& star, float ceiling_height_mm) {
+	const Vector2<float> origin = segment.GetOriginMM();
+	const Vector2<float> size = segment.GetSizeMM();
+	return Vector2<float>(
+		origin.x + star.screen_coords.x * size.x,
+		ceiling_height_mm - origin.y - star.screen_coords.y * size.y);
+}
+
+struct HoleExport {
+	std::string directory{};
+	std::vector<std::shared_ptr<const Segment>> panels{};
+	std::vector<int> stale{};				// panels whose hole files are rewritten
+	bool bBundlesStale = false;
+	float ceiling_height_mm = 0.f;
+	int num_light_engines = 0;
+	int max_fibers_per_bundle = 0;
+
+	// results, set by writeHoleExport
+	std::vector<char> saved{};
+	bool bBundlesSaved = false;
+	float travel_before = 0.f;				// drill travel in mm, in magnitude order and optimized
+	float travel_after = 0.f;
+	double elapsed_ms = 0.0;
+};
+
+/*
+	Groups every hole on the ceiling into bundles per light engine, then writes the illuminator positions
+	with their estimated fiber lengths to bundles.csv and the bundle of every hole to fibers.csv.
+*/
+static bool writeFiberBundles(const HoleExport& job) {
+	std::vector<Vector2<float>> holes;
+	std::vector<std::pair<const Segment*, const Segment::StarData*>> sources;
+	for (const auto& panel : job.panels) {
+		for (const auto& star : panel->GetStars()) {
+			holes.push_back(getCeilingHolePosition(*panel, star, job.ceiling_height_mm));
+			sources.push_back({ panel.get(), &star });
+		}
+	}
+	if (holes.empty()) return true;
+
+	const FiberBundlePlan plan = planFiberBundles(holes, job.num_light_engines, job.max_fibers_per_bundle, FIBER_SLACK_MM,
+		FIBER_BUNDLE_RESTARTS, thread_pool.get());
+
+	BufferedWriter bundles;
+	if (!bundles.Open(job.directory + "/bundles.csv")) return false;
+	bundles.Write("bundle,x_mm,y_mm,fibers,fiber_length_m\n");
+	for (size_t k = 0; k < plan.bundles.size(); k++) {
+		const FiberBundle& bundle = plan.bundles[k];
+		bundles.Write(static_cast<int>(k) + 1).Write(',')
+			.Write(bundle.position.x, 1).Write(',')
+			.Write(bundle.position.y, 1).Write(',')
+			.Write(bundle.num_fibers).Write(',')
+			.Write(bundle.fiber_length / 1000.f, 2).Write('\n');
+		std::cout << "Bundle " << k + 1 << ": " << bundle.num_fibers << " fibers, " << bundle.fiber_length / 1000.f << " m\n";
+	}
+
+	BufferedWriter fibers;
+	if (!fibers.Open(job.directory + "/fibers.csv")) return false;
+	fibers.Write("segment,star_id,x_mm,y_mm,size,bundle\n");
+	for (size_t i = 0; i < holes.size(); i++) {
+		fibers.Write(sources[i].first->GetID()).Write(',')
+			.Write(sources[i].second->id).Write(',')
+			.Write(holes[i].x, 3).Write(',')
+			.Write(holes[i].y, 3).Write(',')
+			.Write(getSizeName(sources[i].second->star_size)).Write(',')
+			.Write(plan.assignment[i] + 1).Write('\n');
+	}
+
+	std::cout << "Fiber: " << plan.total_length / 1000.f << " m in " << plan.bundles.size() << " bundles\n";
+	return bundles.Close() && fibers.Close();
+}
+
+// segment hashes of the hole files last written, by segment ID, and the export being written on the thread pool
+namespace HoleExportState {
+	static std::string directory{};
+	static std::unordered_map<int, uint64_t> hashes{};
+	static std::shared_ptr<HoleExport> pending{};
+	static std::future<bool> job{};
+}
+
+static std::string getHoleFileName(const HoleExport& job, const Segment& segment) {
+	return job.directory + "/segment_" + std::to_string(segment.GetID());
+}
+
+// true if the segment's hole files are missing or were written from different holes
+static bool isHoleExportStale(const Segment& segment, const std::string& name) {
+	auto result = HoleExportState::hashes.find(segment.GetID());
+	if (result == HoleExportState::hashes.end() || result->second != segment.GetHash()) return true;
+
+	std::error_code error;
+	return !std::filesystem::exists(name + ".csv", error) || !std::filesystem::exists(name + ".nc", error);
+}
+
+std::vector<std::shared_ptr<const Segment>> copySegments() {
+	std::vector<std::shared_ptr<const Segment>> panels;
+	panels.reserve(segments.size());
+	for (const auto& segment : segments) {
+		panels.push_back(std::make_shared<const Segment>(segment));
+	}
+	return panels;
+}
+
+std::shared_ptr<HoleExport> prepareHoleExport(const std::string& directory, std::vector<std::shared_ptr<const Segment>> panels) {
+	std::error_code error;
+	std::filesystem::create_directories(directory, error);
+	if (error) {
+		std::cout << "Could not create directory \"" << directory << "\": " << error.message() << "\n";
+		return nullptr;
+	}
+
+	if (directory != HoleExportState::directory) {
+		HoleExportState::directory = directory;
+		HoleExportState::hashes.clear();
+	}
+
+	auto job = std::make_shared<HoleExport>();
+	job->directory = directory;
+	job->panels = std::move(panels);
+	for (int i = 0; i < static_cast<int>(job->panels.size()); i++) {
+		if (isHoleExportStale(*job->panels[i], getHoleFileName(*job, *job->panels[i]))) job->stale.push_back(i);
+	}
+
+	std::error_code exists_error;
+	job->bBundlesStale = !job->stale.empty() || !std::filesystem::exists(directory + "/bundles.csv", exists_error);
+	job->ceiling_height_mm = ceiling_geometry.GetSizeMM().y;
+	job->num_light_engines = num_light_engines;
+	job->max_fibers_per_bundle = max_fibers_per_bundle;
+	job->saved.assign(job->stale.size(), 0);
+	return job;
+}
+
+/*
+	Writes every stale segment's holes in mm, as CSV and as G-code drill cycles, one panel per task, followed
+	by the fiber bundles of the whole ceiling if any segment changed. Drill paths are improved for
+	DRILL_PATH_MAX_PASSES passes at most. Only reads the job's copies, so it can run on a worker itself.
+*/
+bool writeHoleExport(HoleExport& job) {
+	const Uint64 start = SDL_GetPerformanceCounter();
+
+	std::vector<DrillTravel> travel(job.stale.size());
+	auto export_panel = [&job, &travel](int i) {
+		const Segment& panel = *job.panels[job.stale[i]];
+		const std::string name = getHoleFileName(job, panel);
+		job.saved[i] = writeHoleCSV(panel, name + ".csv") && writeHoleGCode(panel, name + ".nc", travel[i]);
+	};
+
+	if (thread_pool) {
+		thread_pool->ParallelFor(static_cast<int>(job.stale.size()), export_panel);
+	}
+	else {
+		for (int i = 0; i < static_cast<int>(job.stale.size()); i++) export_panel(i);
+	}
+
+	for (const auto& panel_travel : travel) {
+		job.travel_before += panel_travel.before;
+		job.travel_after += panel_travel.after;
+	}
+
+	job.bBundlesSaved = !job.bBundlesStale || writeFiberBundles(job);
+	job.elapsed_ms = (SDL_GetPerformanceCounter() - start) * 1000.0 / SDL_GetPerformanceFrequency();
+	return job.bBundlesSaved && std::find(job.saved.begin(), job.saved.end(), 0) == job.saved.end();
+}
+
+bool finishHoleExport(const HoleExport& job) {
+	int num_saved = 0;
+	for (size_t i = 0; i < job.stale.size(); i++) {
+		const Segment& panel = *job.panels[job.stale[i]];
+		if (job.saved[i]) num_saved++;
+
+		// a later export to another directory has already started over
+		if (job.directory != HoleExportState::directory) continue;
+		if (job.saved[i]) {
+			HoleExportState::hashes[panel.GetID()] = panel.GetHash();
+		}
+		else {
+			HoleExportState::hashes.erase(panel.GetID());
+		}
+	}
+
+	std::cout << "Drill travel: " << job.travel_before / 1000.f << " m in magnitude order, " << job.travel_after / 1000.f << " m optimized\n";
+	std::cout << "Exported holes for " << num_saved << " of " << job.stale.size() << " changed segments ("
+		<< job.panels.size() - job.stale.size() << " unchanged) to \"" << job.directory << "\" in " << job.elapsed_ms << " ms\n";
+	return num_saved == static_cast<int>(job.stale.size()) && job.bBundlesSaved;
+}
+
+// Uses the segments of the last full selection
+bool exportHoles(const std::string& directory) {
+	if (bLoadingStars) return false;
+
+	std::shared_ptr<HoleExport> job = prepareHoleExport(directory, copySegments());
+	if (!job) return false;
+
+	writeHoleExport(*job);
+	return finishHoleExport(*job);
+}
+
+/*
+	Selects the stars at full quality and writes their holes on the thread pool, like GENERATE. Returns
+	false while holes or templates are being written.
+*/
+bool startExportHoles(const std::string& directory) {
+	if (bLoadingStars || bGenerating || isExportingHoles()) return false;
+
+	selectStars(RenderQuality::FULL);
+	bStarsChanged = true;
+	if (!thread_pool) return exportHoles(directory);
+
+	std::shared_ptr<HoleExport> job = prepareHoleExport(directory, copySegments());
+	if (!job) return false;
+
+	HoleExportState::pending = job;
+	HoleExportState::job = thread_pool->Submit([job] { return writeHoleExport(*job); });
+	return true;
+}
+
+bool isExportingHoles() {
+	return HoleExportState::job.valid();
+}
+
+// Call once per frame: records the written segments once the holes are exported
+void updateExportHoles() {
+	if (HoleExportState::job.valid() && HoleExportState::job.wait_for(std::chrono::seconds(0)) == std::future_status::ready) {
+		waitForExportHoles();
+	}
+}
+
+void waitForExportHoles() {
+	if (!HoleExportState::job.valid()) return;
+
+	HoleExportState::job.get();
+	finishHoleExport(*HoleExportState::pending);
+	HoleExportState::pending.reset();
+}
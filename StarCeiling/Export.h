@@ -0,0 +1,30 @@
+#pragma once
+
+#include <memory>
+#include <string>
+#include <vector>
+
+class Segment;
+
+bool exportPrint(const std::string& filename);
+bool startExportPrint(const std::string& filename);
+bool isExportingPrint();
+void updateExportPrint();
+void waitForExportPrint();
+
+/*
+	Hole export in three steps: the stale segments are picked on the UI thread, their hole files and the
+	fiber bundles are written on any thread, and the written segments are recorded back on the UI thread.
+	exportHoles does all three in place, startExportHoles runs the middle one on the thread pool.
+*/
+struct HoleExport;
+std::vector<std::shared_ptr<const Segment>> copySegments();
+std::shared_ptr<HoleExport> prepareHoleExport(const std::string& directory, std::vector<std::shared_ptr<const Segment>> panels);
+bool writeHoleExport(HoleExport& job);
+bool finishHoleExport(const HoleExport& job);
+
+bool exportHoles(const std::string& directory);
+bool startExportHoles(const std::string& directory);
+bool isExportingHoles();
+void updateExportHoles();
+void waitForExportHoles();
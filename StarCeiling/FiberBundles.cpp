@@ -0,0 +1,202 @@
+#include "FiberBundles.h"
+#include "ThreadPool.h"
+
+#include <algorithm>
+#include <math.h>
+#include <numeric>
+#include <random>
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define FIBER_BUNDLES_SSE2
+#include <emmintrin.h>
+#endif
+
+static const int MAX_ITERATIONS = 50;
+
+// stands in for the padding centres, far enough that its square still fits in a float
+static const float FAR_AWAY = 1e15f;
+
+namespace {
+	// bundle centres as separate x and y arrays, padded to a multiple of 4 for the distance kernel
+	struct Centres {
+		std::vector<float> x{};
+		std::vector<float> y{};
+		int count = 0;
+
+		explicit Centres(int count) : count{ count } {
+			const size_t padded = (static_cast<size_t>(count) + 3) & ~static_cast<size_t>(3);
+			x.assign(padded, FAR_AWAY);
+			y.assign(padded, FAR_AWAY);
+		}
+
+		int Padded() const { return static_cast<int>(x.size()); }
+	};
+}
+
+// squared distance from the point to every centre
+static void getDistances(Vector2<float> point, const Centres& centres, float* out) {
+	int k = 0;
+#ifdef FIBER_BUNDLES_SSE2
+	const __m128 px = _mm_set1_ps(point.x);
+	const __m128 py = _mm_set1_ps(point.y);
+	for (; k < centres.Padded(); k += 4) {
+		const __m128 dx = _mm_sub_ps(_mm_loadu_ps(centres.x.data() + k), px);
+		const __m128 dy = _mm_sub_ps(_mm_loadu_ps(centres.y.data() + k), py);
+		_mm_storeu_ps(out + k, _mm_add_ps(_mm_mul_ps(dx, dx), _mm_mul_ps(dy, dy)));
+	}
+#endif
+	for (; k < centres.Padded(); k++) {
+		const float dx = centres.x[k] - point.x;
+		const float dy = centres.y[k] - point.y;
+		out[k] = dx * dx + dy * dy;
+	}
+}
+
+// k-means++: each further centre is a hole picked with probability proportional to its squared distance
+static Centres seedCentres(const std::vector<Vector2<float>>& holes, int num_bundles, std::mt19937& random) {
+	Centres centres(num_bundles);
+	std::vector<float> nearest(holes.size(), FAR_AWAY);
+
+	std::uniform_int_distribution<size_t> first(0, holes.size() - 1);
+	size_t pick = first(random);
+	for (int k = 0; k < num_bundles; k++) {
+		centres.x[k] = holes[pick].x;
+		centres.y[k] = holes[pick].y;
+		if (k + 1 == num_bundles) break;
+
+		double total = 0.0;
+		for (size_t i = 0; i < holes.size(); i++) {
+			const float dx = holes[i].x - centres.x[k];
+			const float dy = holes[i].y - centres.y[k];
+			nearest[i] = std::min(nearest[i], dx * dx + dy * dy);
+			total += nearest[i];
+		}
+		if (total <= 0.0) continue; // every hole already sits on a centre
+
+		double target = std::uniform_real_distribution<double>(0.0, total)(random);
+		pick = holes.size() - 1;
+		for (size_t i = 0; i < holes.size(); i++) {
+			target -= nearest[i];
+			if (target <= 0.0) {
+				pick = i;
+				break;
+			}
+		}
+	}
+
+	return centres;
+}
+
+/*
+	Assigns every hole to the nearest centre with room left. Holes that lose most by missing their nearest
+	centre go first, so the holes pushed out of a full bundle are the ones with a close alternative.
+*/
+static void assignHoles(const std::vector<Vector2<float>>& holes, const Centres& centres, int max_fibers,
+	std::vector<float>& distances, std::vector<int>& assignment) {
+	const int padded = centres.Padded();
+	std::vector<float> regret(holes.size());
+	for (size_t i = 0; i < holes.size(); i++) {
+		float* row = distances.data() + i * padded;
+		getDistances(holes[i], centres, row);
+
+		float best = FAR_AWAY;
+		float second = FAR_AWAY;
+		for (int k = 0; k < centres.count; k++) {
+			if (row[k] < best) {
+				second = best;
+				best = row[k];
+			}
+			else if (row[k] < second) {
+				second = row[k];
+			}
+		}
+		regret[i] = sqrtf(second) - sqrtf(best);
+	}
+
+	std::vector<int> order(holes.size());
+	std::iota(order.begin(), order.end(), 0);
+	std::stable_sort(order.begin(), order.end(), [&regret](int a, int b) { return regret[a] > regret[b]; });
+
+	std::vector<int> counts(centres.count, 0);
+	for (int i : order) {
+		const float* row = distances.data() + static_cast<size_t>(i) * padded;
+		int best = -1;
+		for (int k = 0; k < centres.count; k++) {
+			if (counts[k] < max_fibers && (best < 0 || row[k] < row[best])) best = k;
+		}
+		assignment[i] = best;
+		counts[best]++;
+	}
+}
+
+static FiberBundlePlan runKMeans(const std::vector<Vector2<float>>& holes, int num_bundles, int max_fibers, float slack, unsigned int seed) {
+	std::mt19937 random(seed);
+	Centres centres = seedCentres(holes, num_bundles, random);
+
+	std::vector<float> distances(holes.size() * centres.Padded());
+	std::vector<int> assignment(holes.size(), -1);
+	std::vector<int> previous;
+	std::vector<double> sum_x(num_bundles), sum_y(num_bundles);
+	std::vector<int> counts(num_bundles);
+
+	for (int iteration = 0; iteration < MAX_ITERATIONS; iteration++) {
+		previous = assignment;
+		assignHoles(holes, centres, max_fibers, distances, assignment);
+		if (assignment == previous) break;
+
+		// move each centre to the mean of its holes, empty bundles stay put
+		std::fill(sum_x.begin(), sum_x.end(), 0.0);
+		std::fill(sum_y.begin(), sum_y.end(), 0.0);
+		std::fill(counts.begin(), counts.end(), 0);
+		for (size_t i = 0; i < holes.size(); i++) {
+			sum_x[assignment[i]] += holes[i].x;
+			sum_y[assignment[i]] += holes[i].y;
+			counts[assignment[i]]++;
+		}
+		for (int k = 0; k < num_bundles; k++) {
+			if (counts[k] == 0) continue;
+			centres.x[k] = static_cast<float>(sum_x[k] / counts[k]);
+			centres.y[k] = static_cast<float>(sum_y[k] / counts[k]);
+		}
+	}
+
+	FiberBundlePlan plan;
+	plan.assignment = std::move(assignment);
+	plan.bundles.resize(num_bundles);
+	for (int k = 0; k < num_bundles; k++) {
+		plan.bundles[k].position = Vector2<float>(centres.x[k], centres.y[k]);
+	}
+	for (size_t i = 0; i < holes.size(); i++) {
+		FiberBundle& bundle = plan.bundles[plan.assignment[i]];
+		bundle.num_fibers++;
+		bundle.fiber_length += hypotf(holes[i].x - bundle.position.x, holes[i].y - bundle.position.y) + slack;
+	}
+	for (const auto& bundle : plan.bundles) {
+		plan.total_length += bundle.fiber_length;
+	}
+	return plan;
+}
+
+FiberBundlePlan planFiberBundles(const std::vector<Vector2<float>>& holes, int num_bundles, int max_fibers, float slack, int restarts, ThreadPool* pool) {
+	if (holes.empty() || max_fibers <= 0) return FiberBundlePlan{};
+
+	const int hole_count = static_cast<int>(holes.size());
+	num_bundles = std::clamp(num_bundles, (hole_count + max_fibers - 1) / max_fibers, hole_count);
+	restarts = std::max(restarts, 1);
+
+	std::vector<FiberBundlePlan> plans(restarts);
+	auto run = [&](int restart) {
+		plans[restart] = runKMeans(holes, num_bundles, max_fibers, slack, static_cast<unsigned int>(restart) * 7919u + 1u);
+	};
+
+	if (pool) {
+		pool->ParallelFor(restarts, run);
+	}
+	else {
+		for (int restart = 0; restart < restarts; restart++) run(restart);
+	}
+
+	auto best = std::min_element(plans.begin(), plans.end(),
+		[](const FiberBundlePlan& a, const FiberBundlePlan& b) { return a.total_length < b.total_length; });
+	return std::move(*best);
+}
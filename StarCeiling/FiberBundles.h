@@ -0,0 +1,27 @@
+#pragma once
+
+#include <vector>
+#include "types.h"
+
+class ThreadPool;
+
+// one light engine and the fibers routed to it
+struct FiberBundle {
+	Vector2<float> position{ 0.f, 0.f };	// illuminator, in the holes' coordinates
+	int num_fibers = 0;
+	float fiber_length = 0.f;				// estimated total, straight runs plus slack per fiber
+};
+
+struct FiberBundlePlan {
+	std::vector<int> assignment{};			// bundle of every hole
+	std::vector<FiberBundle> bundles{};
+	float total_length = 0.f;
+};
+
+/*
+	Groups the holes into num_bundles bundles of at most max_fibers fibers each, placing each illuminator at
+	the centre of its holes: a capacity-constrained k-means, run from several random seeds in parallel,
+	keeping the plan with the shortest total fiber length. If the bundles can't hold every hole, more are
+	used. slack is added to the length of every fiber.
+*/
+FiberBundlePlan planFiberBundles(const std::vector<Vector2<float>>& holes, int num_bundles, int max_fibers, float slack, int restarts, ThreadPool* pool);
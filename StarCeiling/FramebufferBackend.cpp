@@ -0,0 +1,111 @@
+#include "FramebufferBackend.h"
+#include "globals.h"
+#include "graphics.h"
+#include <iostream>
+
+// integer draw calls address pixels, the rasterizer addresses pixel edges
+static const float PIXEL_CENTRE = 0.5f;
+
+FramebufferBackend::FramebufferBackend(Vector2<int> size) {
+	rasterizer_.Resize(size.x, size.y);
+}
+
+bool FramebufferBackend::DrawLine(Vector2<float> start, Vector2<float> end, const RGBA& colour) {
+	rasterizer_.AddLine(
+		Vector2<float>(start.x + PIXEL_CENTRE, start.y + PIXEL_CENTRE),
+		Vector2<float>(end.x + PIXEL_CENTRE, end.y + PIXEL_CENTRE),
+		colour);
+	return true;
+}
+
+bool FramebufferBackend::DrawPolylines(const Polylines& lines, const RGBA& colour) {
+	int start = 0;
+	for (int end : lines.ends) {
+		for (int i = start + 1; i < end; i++) {
+			DrawLine(lines.points[i - 1], lines.points[i], colour);
+		}
+		start = end;
+	}
+	return true;
+}
+
+bool FramebufferBackend::DrawRect(Vector2<int> start, Vector2<int> size, const RGBA& colour) {
+	if (size.x <= 0 || size.y <= 0) return true;
+
+	rasterizer_.AddRect(start.x, start.y, size.x, 1, colour);
+	if (size.y > 1) rasterizer_.AddRect(start.x, start.y + size.y - 1, size.x, 1, colour);
+	if (size.y > 2) {
+		rasterizer_.AddRect(start.x, start.y + 1, 1, size.y - 2, colour);
+		if (size.x > 1) rasterizer_.AddRect(start.x + size.x - 1, start.y + 1, 1, size.y - 2, colour);
+	}
+	return true;
+}
+
+bool FramebufferBackend::FillRect(Vector2<int> start, Vector2<int> size, const RGBA& colour) {
+	rasterizer_.AddRect(start.x, start.y, size.x, size.y, colour);
+	return true;
+}
+
+bool FramebufferBackend::DrawSurface(SDL_Surface* surface, Vector2<int> position) {
+	SDL_Surface* rgba = SDL_ConvertSurfaceFormat(surface, SDL_PIXELFORMAT_RGBA32, 0);
+	if (!rgba) {
+		std::cout << "Failed to convert surface: " << SDL_GetError() << "\n";
+		return false;
+	}
+
+	SDL_LockSurface(rgba);
+	rasterizer_.AddImage(position.x, position.y, rgba->w, rgba->h, static_cast<const uint8_t*>(rgba->pixels), rgba->pitch);
+	SDL_UnlockSurface(rgba);
+	SDL_FreeSurface(rgba);
+	return true;
+}
+
+bool FramebufferBackend::BeginStarLayer(Vector2<int> size) {
+	rasterizer_.Resize(size.x, size.y);
+	rasterizer_.Clear();
+	return true;
+}
+
+// Both qualities are splatted; there is no per-primitive cost to save on the CPU path
+void FramebufferBackend::DrawStars(const std::vector<SelectedStar>& stars, RenderQuality) {
+	for (const auto& star : stars) {
+		rasterizer_.AddStar(star.position, getStarRadius(star.size), star.colour, star.brightness);
+	}
+}
+
+void FramebufferBackend::EndStarLayer() {
+	rasterizer_.Rasterize(thread_pool.get());
+}
+
+const std::vector<uint8_t>& FramebufferBackend::Resolve() {
+	const int pitch = GetWidth() * 4;
+	pixels_.resize(static_cast<size_t>(pitch) * GetHeight());
+	rasterizer_.Resolve(pixels_.data(), pitch, thread_pool.get());
+	return pixels_;
+}
+
+bool FramebufferBackend::Save(const std::string& filename, const SDL_Rect& region) {
+	Resolve();
+
+	SDL_Rect bounds = SDL_Rect{ 0, 0, GetWidth(), GetHeight() };
+	SDL_Rect crop;
+	if (!SDL_IntersectRect(&region, &bounds, &crop)) {
+		std::cout << "Nothing to save to " << filename << "\n";
+		return false;
+	}
+
+	const int pitch = GetWidth() * 4;
+	uint8_t* origin = pixels_.data() + static_cast<size_t>(crop.y) * pitch + static_cast<size_t>(crop.x) * 4;
+	SDL_Surface* surface = SDL_CreateRGBSurfaceWithFormatFrom(origin, crop.w, crop.h, 32, pitch, SDL_PIXELFORMAT_RGBA32);
+	if (!surface) {
+		std::cout << "Failed to create surface: " << SDL_GetError() << "\n";
+		return false;
+	}
+
+	const bool bSaved = SDL_SaveBMP(surface, filename.c_str()) == 0;
+	if (!bSaved) {
+		std::cout << "Failed to save " << filename << ": " << SDL_GetError() << "\n";
+	}
+	SDL_FreeSurface(surface);
+	return bSaved;
+}
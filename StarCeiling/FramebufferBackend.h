@@ -0,0 +1,40 @@
+#pragma once
+
+#include <string>
+#include <vector>
+#include "RenderBackend.h"
+#include "Rasterizer.h"
+
+/*
+	Draws into an in-memory RGBA image on the CPU, so the ceiling can be rendered without a window, display or
+	GPU (e.g. on a build server). The star layer is the framebuffer itself; anything drawn afterwards uses the
+	same star layer pixel coordinates.
+*/
+class FramebufferBackend : public RenderBackend
+{
+private:
+	Rasterizer rasterizer_{};
+	std::vector<uint8_t> pixels_{}; // RGBA32, filled by Resolve()
+
+public:
+	explicit FramebufferBackend(Vector2<int> size);
+
+	bool DrawLine(Vector2<float> start, Vector2<float> end, const RGBA& colour) override;
+	bool DrawPolylines(const Polylines& lines, const RGBA& colour) override;
+	bool DrawRect(Vector2<int> start, Vector2<int> size, const RGBA& colour) override;
+	bool FillRect(Vector2<int> start, Vector2<int> size, const RGBA& colour) override;
+	bool DrawSurface(SDL_Surface* surface, Vector2<int> position) override;
+
+	bool BeginStarLayer(Vector2<int> size) override;
+	void DrawStars(const std::vector<SelectedStar>& stars, RenderQuality quality) override;
+	void EndStarLayer() override;
+
+	// Converts everything drawn so far to RGBA32 pixels and clears the drawing buffer
+	const std::vector<uint8_t>& Resolve();
+
+	// Resolves and writes the region of the framebuffer to a BMP file
+	bool Save(const std::string& filename, const SDL_Rect& region);
+
+	int GetWidth() const { return rasterizer_.GetWidth(); }
+	int GetHeight() const { return rasterizer_.GetHeight(); }
+};
@@ -0,0 +1,351 @@
+#include "Framing.h"
+#include "CeilingMask.h"
+#include "SurfaceProjection.h"
+#include "ThreadPool.h"
+
+#include <algorithm>
+#include <array>
+#include <chrono>
+#include <math.h>
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define FRAMING_SSE2
+#include <emmintrin.h>
+#endif
+
+// coarse grid
+static const int TIME_STEPS = 24;
+static const int ROTATION_STEPS = 24;
+static const int ZOOM_STEPS = 6;
+static const int PAN_STEPS = 7;
+static const int TIME_STRIDE = 4;			// times are scored this far apart first, so a cut short pass still spans the night
+static const float MAX_PAN = 1.f;			// the zenith stays within the horizon's radius of the centre
+
+static const int KEEP = 12;					// framings refined in every round
+static const int REFINE_ROUNDS = 6;
+
+// closer framings win ties, when the same brightest stars fit at several zooms
+static const float ZOOM_PREFERENCE = 0.01f;
+
+static const float TWO_PI = 6.2831853f;
+static const float HALF_PI = 1.5707963f;
+
+namespace {
+	enum Axis { TIME, ROTATION, LOG_ZOOM, PAN_X, PAN_Y, NUM_AXES };
+	using Params = std::array<float, NUM_AXES>;
+
+	struct Candidate {
+		Params params{};
+		float score = 0.f;
+		int num_constellations = 0;
+		float flux = 0.f;
+	};
+
+	// framings sharing a time and rotation, which share the projected stars
+	struct Task {
+		float time = 0.f;
+		float rotation = 0.f;
+		std::vector<Params> views{};
+	};
+
+	// the stars at one time and rotation, in normalized screen coordinates, padded to a multiple of 4
+	struct Projected {
+		std::vector<float> x{};
+		std::vector<float> y{};
+		std::vector<int> visible{};	// -1 above the horizon, 0 below
+		std::vector<int> inside{};	// per framing: -1 on the ceiling
+	};
+}
+
+/*
+	Turns the stars by time and latitude as the stars themselves are transformed, projects them like
+	Star::UpdateTransforms and maps them onto the ceiling turned by north plus rotation.
+*/
+static void projectStars(const FramingProblem& problem, float time, float rotation, Projected& out) {
+	const size_t count = problem.stars.size();
+	const size_t padded = (count + 3) & ~static_cast<size_t>(3);
+	out.x.assign(padded, 0.f);
+	out.y.assign(padded, 0.f);
+	out.visible.assign(padded, 0);
+	out.inside.resize(padded);
+
+	const float cos_time = cosf(time);
+	const float sin_time = sinf(time);
+	const float cos_latitude = cosf(problem.latitude);
+	const float sin_latitude = sinf(problem.latitude);
+	const float cos_rotation = cosf(problem.north + rotation);
+	const float sin_rotation = sinf(problem.north + rotation);
+
+	for (size_t i = 0; i < count; i++) {
+		const Vector3<float>& star = problem.stars[i];
+
+		// about Y by time, then about X by latitude
+		const float x = star.x * cos_time + star.z * sin_time;
+		const float z_time = star.z * cos_time - star.x * sin_time;
+		const float y = star.y * cos_latitude - z_time * sin_latitude;
+		const float z = star.y * sin_latitude + z_time * cos_latitude;
+		if (z <= 0.f) continue;
+
+		const float theta_n = acosf(std::min(z, 1.f)) / HALF_PI;
+		const float r = sqrtf(x * x + y * y);
+		const float flat_x = r > 0.f ? theta_n * x / r : 0.f;
+		const float flat_y = r > 0.f ? theta_n * y / r : 0.f;
+
+		Vector2<float> coords_n(flat_x * cos_rotation - flat_y * sin_rotation, flat_x * sin_rotation + flat_y * cos_rotation);
+		if (problem.surface) coords_n = problem.surface->Map(coords_n);
+
+		out.x[i] = coords_n.x;
+		out.y[i] = coords_n.y;
+		out.visible[i] = -1;
+	}
+}
+
+// scores one zoom and pan of the projected stars
+static void scoreFraming(const FramingProblem& problem, float flux_total, Projected& stars, Candidate& candidate) {
+	const float zoom = expf(candidate.params[LOG_ZOOM]);
+	const float scale = problem.coefficient * zoom;
+	const float offset_x = static_cast<float>(problem.ceiling_size.x / 2) + candidate.params[PAN_X] * scale;
+	const float offset_y = static_cast<float>(problem.ceiling_size.y / 2) + candidate.params[PAN_Y] * scale;
+
+	// the in-bounds test of ProjectionCache::Transform
+	const size_t padded = stars.x.size();
+	size_t i = 0;
+#ifdef FRAMING_SSE2
+	const __m128 scale_v = _mm_set1_ps(scale);
+	const __m128 offset_x_v = _mm_set1_ps(offset_x);
+	const __m128 offset_y_v = _mm_set1_ps(offset_y);
+	const __m128i zero = _mm_setzero_si128();
+	const __m128i width = _mm_set1_epi32(problem.ceiling_size.x);
+	const __m128i height = _mm_set1_epi32(problem.ceiling_size.y);
+	for (; i < padded; i += 4) {
+		const __m128i x = _mm_cvtps_epi32(_mm_add_ps(_mm_mul_ps(_mm_loadu_ps(&stars.x[i]), scale_v), offset_x_v));
+		const __m128i y = _mm_cvtps_epi32(_mm_add_ps(_mm_mul_ps(_mm_loadu_ps(&stars.y[i]), scale_v), offset_y_v));
+		__m128i inside = _mm_and_si128(_mm_cmpgt_epi32(x, zero), _mm_cmplt_epi32(x, width));
+		inside = _mm_and_si128(inside, _mm_and_si128(_mm_cmpgt_epi32(y, zero), _mm_cmplt_epi32(y, height)));
+		inside = _mm_and_si128(inside, _mm_loadu_si128(reinterpret_cast<const __m128i*>(&stars.visible[i])));
+		_mm_storeu_si128(reinterpret_cast<__m128i*>(&stars.inside[i]), inside);
+	}
+#endif
+	for (; i < padded; i++) {
+		const int x = static_cast<int>(lrintf(stars.x[i] * scale + offset_x));
+		const int y = static_cast<int>(lrintf(stars.y[i] * scale + offset_y));
+		const bool bInside = x > 0 && x < problem.ceiling_size.x && y > 0 && y < problem.ceiling_size.y;
+		stars.inside[i] = bInside ? stars.visible[i] : 0;
+	}
+
+	// the brightest stars up to the budget are the ones that get holes
+	const size_t count = problem.stars.size();
+	const bool bMasked = problem.mask && !problem.mask->IsRectangular();
+	int num_selected = 0;
+	float flux = 0.f;
+	for (size_t star = 0; star < count; star++) {
+		if (!stars.inside[star]) continue;
+		if (bMasked && !problem.mask->Contains(static_cast<int>(lrintf(stars.x[star] * scale + offset_x)),
+			static_cast<int>(lrintf(stars.y[star] * scale + offset_y)))) {
+			stars.inside[star] = 0;
+			continue;
+		}
+
+		if (num_selected < problem.budget) {
+			flux += problem.flux[star];
+			num_selected++;
+		}
+	}
+
+	int num_constellations = 0;
+	for (const auto& constellation : problem.constellations) {
+		bool bInside = !constellation.empty();
+		for (int star : constellation) {
+			if (!stars.inside[star]) {
+				bInside = false;
+				break;
+			}
+		}
+		if (bInside) num_constellations++;
+	}
+
+	const float max_log_zoom = logf(std::max(problem.max_zoom, 1.f));
+	candidate.num_constellations = num_constellations;
+	candidate.flux = flux_total > 0.f ? flux / flux_total : 0.f;
+	candidate.score = num_constellations + candidate.flux
+		+ (max_log_zoom > 0.f ? ZOOM_PREFERENCE * candidate.params[LOG_ZOOM] / max_log_zoom : 0.f);
+}
+
+using Clock = std::chrono::steady_clock;
+
+// scores every view of every task started before the deadline, in task order; later tasks are left out
+static std::vector<Candidate> scoreTasks(const FramingProblem& problem, float flux_total, const std::vector<Task>& tasks,
+	Clock::time_point deadline, ThreadPool* pool) {
+	std::vector<size_t> starts(tasks.size() + 1, 0);
+	for (size_t t = 0; t < tasks.size(); t++) {
+		starts[t + 1] = starts[t] + tasks[t].views.size();
+	}
+
+	std::vector<Candidate> candidates(starts.back());
+	std::vector<char> scored(tasks.size(), 0);
+	auto run = [&](int t) {
+		if (Clock::now() >= deadline) return;
+
+		const Task& task = tasks[t];
+		Projected stars;
+		projectStars(problem, task.time, task.rotation, stars);
+		for (size_t v = 0; v < task.views.size(); v++) {
+			Candidate& candidate = candidates[starts[t] + v];
+			candidate.params = task.views[v];
+			candidate.params[TIME] = task.time;
+			candidate.params[ROTATION] = task.rotation;
+			scoreFraming(problem, flux_total, stars, candidate);
+		}
+		scored[t] = 1;
+	};
+
+	if (pool) {
+		pool->ParallelFor(static_cast<int>(tasks.size()), run);
+	}
+	else {
+		for (int t = 0; t < static_cast<int>(tasks.size()); t++) run(t);
+	}
+
+	size_t kept = 0;
+	for (size_t t = 0; t < tasks.size(); t++) {
+		if (!scored[t]) continue;
+		for (size_t c = starts[t]; c < starts[t + 1]; c++) candidates[kept++] = candidates[c];
+	}
+	candidates.erase(candidates.begin() + kept, candidates.end());
+	return candidates;
+}
+
+static float angleDistance(float a, float b) {
+	const float d = fmodf(fabsf(a - b), TWO_PI);
+	return std::min(d, TWO_PI - d);
+}
+
+// framings closer than a step on every axis count as the same
+static bool isNear(const Params& a, const Params& b, const Params& steps) {
+	return angleDistance(a[TIME], b[TIME]) < steps[TIME]
+		&& angleDistance(a[ROTATION], b[ROTATION]) < steps[ROTATION]
+		&& fabsf(a[LOG_ZOOM] - b[LOG_ZOOM]) < steps[LOG_ZOOM]
+		&& fabsf(a[PAN_X] - b[PAN_X]) < steps[PAN_X]
+		&& fabsf(a[PAN_Y] - b[PAN_Y]) < steps[PAN_Y];
+}
+
+// the best candidates, skipping any near a better one already kept
+static std::vector<Candidate> keepBest(std::vector<Candidate>& candidates, size_t count, const Params& steps) {
+	std::sort(candidates.begin(), candidates.end(), [](const Candidate& a, const Candidate& b) { return a.score > b.score; });
+
+	std::vector<Candidate> kept;
+	for (const Candidate& candidate : candidates) {
+		if (kept.size() >= count) break;
+
+		bool bDistinct = true;
+		for (const Candidate& other : kept) {
+			if (isNear(candidate.params, other.params, steps)) {
+				bDistinct = false;
+				break;
+			}
+		}
+		if (bDistinct) kept.push_back(candidate);
+	}
+	return kept;
+}
+
+static float wrapAngle(float angle) {
+	angle = fmodf(angle, TWO_PI);
+	return angle < 0.f ? angle + TWO_PI : angle;
+}
+
+std::vector<Framing> searchFramings(const FramingProblem& problem, int num_results, double time_budget_ms, ThreadPool* pool) {
+	if (problem.stars.empty() || problem.ceiling_size.x <= 0 || problem.ceiling_size.y <= 0 || num_results <= 0) return {};
+
+	const Clock::time_point deadline = Clock::now()
+		+ std::chrono::duration_cast<Clock::duration>(std::chrono::duration<double, std::milli>(time_budget_ms));
+
+	// flux of the brightest stars the budget allows, captured if every one of them is on the ceiling
+	float flux_total = 0.f;
+	const size_t budget = std::min(static_cast<size_t>(std::max(problem.budget, 0)), problem.flux.size());
+	for (size_t i = 0; i < budget; i++) flux_total += problem.flux[i];
+
+	const float max_log_zoom = logf(std::max(problem.max_zoom, 1.f));
+	Params steps{};
+	steps[TIME] = TWO_PI / TIME_STEPS;
+	steps[ROTATION] = TWO_PI / ROTATION_STEPS;
+	steps[LOG_ZOOM] = max_log_zoom / std::max(ZOOM_STEPS - 1, 1);
+	steps[PAN_X] = 2.f * MAX_PAN / (PAN_STEPS - 1);
+	steps[PAN_Y] = steps[PAN_X];
+
+	// coarse grid, one task per time and rotation, with the times interleaved
+	std::vector<Params> views;
+	for (int z = 0; z < ZOOM_STEPS; z++) {
+		for (int py = 0; py < PAN_STEPS; py++) {
+			for (int px = 0; px < PAN_STEPS; px++) {
+				Params view{};
+				view[LOG_ZOOM] = std::min(z * steps[LOG_ZOOM], max_log_zoom);
+				view[PAN_X] = -MAX_PAN + px * steps[PAN_X];
+				view[PAN_Y] = -MAX_PAN + py * steps[PAN_Y];
+				views.push_back(view);
+			}
+		}
+	}
+
+	std::vector<Task> tasks;
+	for (int first = 0; first < TIME_STRIDE; first++) {
+		for (int t = first; t < TIME_STEPS; t += TIME_STRIDE) {
+			for (int r = 0; r < ROTATION_STEPS; r++) {
+				tasks.push_back(Task{ t * steps[TIME], r * steps[ROTATION], views });
+			}
+		}
+	}
+
+	std::vector<Candidate> candidates = scoreTasks(problem, flux_total, tasks, deadline, pool);
+	// framings within a coarse step of a better one are dropped, so each kept framing refines a different optimum
+	const Params coarse_steps = steps;
+	std::vector<Candidate> best = keepBest(candidates, std::max(static_cast<size_t>(KEEP), static_cast<size_t>(num_results)), coarse_steps);
+
+	// refine around the best framings with halved steps, keeping the previous best in the running
+	for (int round = 0; round < REFINE_ROUNDS && Clock::now() < deadline; round++) {
+		for (float& step : steps) step *= 0.5f;
+
+		tasks.clear();
+		for (const Candidate& centre : best) {
+			views.clear();
+			for (int dz = -1; dz <= 1; dz++) {
+				for (int dy = -1; dy <= 1; dy++) {
+					for (int dx = -1; dx <= 1; dx++) {
+						Params view = centre.params;
+						view[LOG_ZOOM] = std::clamp(view[LOG_ZOOM] + dz * steps[LOG_ZOOM], 0.f, max_log_zoom);
+						view[PAN_X] = std::clamp(view[PAN_X] + dx * steps[PAN_X], -MAX_PAN, MAX_PAN);
+						view[PAN_Y] = std::clamp(view[PAN_Y] + dy * steps[PAN_Y], -MAX_PAN, MAX_PAN);
+						views.push_back(view);
+					}
+				}
+			}
+
+			for (int dt = -1; dt <= 1; dt++) {
+				for (int dr = -1; dr <= 1; dr++) {
+					tasks.push_back(Task{ wrapAngle(centre.params[TIME] + dt * steps[TIME]),
+						wrapAngle(centre.params[ROTATION] + dr * steps[ROTATION]), views });
+				}
+			}
+		}
+
+		candidates = scoreTasks(problem, flux_total, tasks, deadline, pool);
+		candidates.insert(candidates.end(), best.begin(), best.end());
+		best = keepBest(candidates, best.size(), coarse_steps);
+	}
+
+	std::vector<Framing> framings;
+	for (const Candidate& candidate : best) {
+		if (static_cast<int>(framings.size()) >= num_results) break;
+
+		Framing framing;
+		framing.earth_rotation = candidate.params[TIME];
+		framing.sky_rotation = candidate.params[ROTATION];
+		framing.zoom = expf(candidate.params[LOG_ZOOM]);
+		framing.pan = Vector2<float>(candidate.params[PAN_X], candidate.params[PAN_Y]);
+		framing.score = candidate.score;
+		framing.num_constellations = candidate.num_constellations;
+		framing.flux = candidate.flux;
+		framings.push_back(framing);
+	}
+	return framings;
+}
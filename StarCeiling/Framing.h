@@ -0,0 +1,43 @@
+#pragma once
+
+#include <vector>
+#include "types.h"
+
+class ThreadPool;
+class SurfaceProjection;
+class CeilingMask;
+
+// one way of putting the sky on the ceiling
+struct Framing {
+	float earth_rotation = 0.f;			// time of night, radians
+	float sky_rotation = 0.f;			// radians clockwise, on top of the ceiling's north
+	float zoom = 1.f;
+	Vector2<float> pan{ 0.f, 0.f };		// zenith offset from the ceiling centre, in normalized screen units
+	float score = 0.f;
+	int num_constellations = 0;			// required constellations fully on the ceiling
+	float flux = 0.f;					// fraction of the brightest stars' flux on the ceiling
+};
+
+// the stars to frame and the ceiling they are projected onto
+struct FramingProblem {
+	std::vector<Vector3<float>> stars{};				// absolute locations, brightest first
+	std::vector<float> flux{};
+	std::vector<std::vector<int>> constellations{};	// star indices of every required constellation
+	int budget = 0;									// holes available, only the brightest this many on the ceiling count
+	float latitude = 0.f;
+	float north = 0.f;
+	float coefficient = 1.f;						// pixels per normalized screen unit at zoom 1
+	Vector2<int> ceiling_size{ 0, 0 };
+	float max_zoom = 1.f;
+	const SurfaceProjection* surface = nullptr;		// null for a flat ceiling
+	const CeilingMask* mask = nullptr;				// null for the whole rectangle
+};
+
+/*
+	Searches time, sky rotation, zoom and pan for the framings with the highest score: one point for every
+	required constellation fully on the ceiling, plus the fraction of the brightest stars' flux captured.
+	A coarse grid over all of them is scored in parallel, then the best few are refined with halved steps
+	until the rounds run out. Both passes stop starting work once the time budget is spent. Returns up to
+	num_results distinct framings, best first; none if the budget ran out before anything was scored.
+*/
+std::vector<Framing> searchFramings(const FramingProblem& problem, int num_results, double time_budget_ms, ThreadPool* pool);
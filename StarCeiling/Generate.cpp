@@ -0,0 +1,200 @@
+#include <math.h>
+#include <filesystem>
+#include <functional>
+#include <future>
+#include <iostream>
+#include <memory>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include "Generate.h"
+#include "globals.h"
+#include "graphics.h"
+#include "PngWriter.h"
+#include "Export.h"
+#include "ThreadPool.h"
+#include "utilities.h"
+
+// templates and hole lists being drawn and saved on the thread pool
+namespace GenerateState {
+	static std::vector<std::future<bool>> jobs{};
+	static std::vector<std::pair<int, uint64_t>> job_segments{};	// segment ID and template key of every job
+	static std::unordered_map<int, uint64_t> saved_hashes{};		// template keys of the templates on disk
+	static std::shared_ptr<HoleExport> holes{};
+	static std::future<bool> holes_job{};
+}
+
+// runs the job on the thread pool, or right away without one
+static std::future<bool> submitJob(std::function<bool()> job) {
+	if (thread_pool) return thread_pool->Submit(std::move(job));
+
+	std::promise<bool> result;
+	result.set_value(job());
+	return result.get_future();
+}
+
+/*
+	What a template is drawn from: the segment's holes and the north marker's angle. A sky rotation that
+	leaves the quantized holes where they were still turns the marker.
+*/
+static uint64_t getTemplateKey(const Segment& segment, float north) {
+	return hashCombine(static_cast<size_t>(segment.GetHash()), north);
+}
+
+// true if the template is missing or was drawn from different holes or a different north
+static bool isTemplateStale(const Segment& segment, uint64_t key, const std::string& filename) {
+	auto result = GenerateState::saved_hashes.find(segment.GetID());
+	if (result == GenerateState::saved_hashes.end() || result->second != key) return true;
+
+	std::error_code error;
+	return !std::filesystem::exists(filename, error);
+}
+
+static bool saveTemplate(SDL_Surface* surface, const std::string& filename) {
+	PngWriter png;
+	if (!png.Open(filename, surface->w, surface->h)) return false;
+
+	const uint8_t* pixels = static_cast<const uint8_t*>(surface->pixels);
+	for (int y = 0; y < surface->h; y++) {
+		png.WriteRow(pixels + static_cast<size_t>(y) * surface->pitch);
+	}
+	return png.Close();
+}
+
+/*
+	Draws and saves one segment's template, run on a worker. Takes ownership of label.
+*/
+static bool generateTemplate(std::shared_ptr<const Segment> segment, SDL_Surface* label, float px_per_mm, float north, std::string filename) {
+	SDL_Surface* surface = segment->CreateTemplate(px_per_mm, north, label);
+	if (label) SDL_FreeSurface(label);
+
+	const bool bSaved = surface && saveTemplate(surface, filename);
+	if (surface) SDL_FreeSurface(surface);
+
+	generate_done++;
+	return bSaved;
+}
+
+/*
+	GENERATE: selects the stars at full quality, bins them into the segments, then exports their hole lists
+	and draws the drilling templates concurrently on the thread pool, saving them to HOLE_DIRECTORY and
+	TEMPLATE_DIRECTORY. Only segments whose holes changed since they were saved are redone. Returns
+	immediately; updateGenerate() collects the results while the button shows the progress.
+*/
+void startGenerate() {
+	if (bGenerating || bLoadingStars || isExportingHoles()) return;
+
+	// the templates show exactly what the current view would at full quality
+	selectStars(RenderQuality::FULL);
+	bStarsChanged = true;
+
+	// the workers read copies, the segments change with the next full selection
+	const std::vector<std::shared_ptr<const Segment>> panels = copySegments();
+	generate_done = 0;
+
+	// the hole lists of every panel are one job
+	GenerateState::holes = prepareHoleExport(HOLE_DIRECTORY, panels);
+	if (GenerateState::holes) {
+		std::shared_ptr<HoleExport> holes = GenerateState::holes;
+		GenerateState::holes_job = submitJob([holes] {
+			const bool bSaved = writeHoleExport(*holes);
+			generate_done++;
+			return bSaved;
+		});
+	}
+
+	std::error_code error;
+	std::filesystem::create_directories(TEMPLATE_DIRECTORY, error);
+	const bool bTemplates = !error;
+	if (error) {
+		std::cout << "Could not create directory \"" << TEMPLATE_DIRECTORY << "\": " << error.message() << "\n";
+	}
+
+	const float px_per_mm = TEMPLATE_DPI / MM_PER_INCH;
+
+	// the stars are turned by the ceiling's north and then the sky rotation, see projectToCeiling()
+	const float north = ceiling_geometry.GetNorth() + sky_rotation;
+
+	// fonts aren't thread safe, so the labels are rendered here
+	TTF_Font* font = nullptr;
+	if (bTemplates) {
+		font = TTF_OpenFont((Environment::fontname + ".ttf").c_str(), static_cast<int>(EXPORT_LABEL_HEIGHT_MM * px_per_mm));
+		if (!font) std::cout << "Failed to load label font: " << TTF_GetError() << "\n";
+	}
+
+	int num_unchanged = 0;
+	for (const auto& segment : panels) {
+		if (!bTemplates) break;
+
+		const int id = segment->GetID();
+		const std::string filename = TEMPLATE_DIRECTORY + "/segment_" + std::to_string(id) + ".png";
+		const uint64_t key = getTemplateKey(*segment, north);
+		if (!isTemplateStale(*segment, key, filename)) {
+			num_unchanged++;
+			continue;
+		}
+
+		SDL_Surface* label = nullptr;
+		if (font) {
+			label = TTF_RenderText_Blended(font, std::to_string(id).c_str(), SDL_Color{ 0, 0, 0, SDL_ALPHA_OPAQUE });
+		}
+
+		GenerateState::job_segments.push_back({ id, key });
+		GenerateState::jobs.push_back(submitJob([segment, label, px_per_mm, north, filename] {
+			return generateTemplate(segment, label, px_per_mm, north, filename);
+		}));
+	}
+
+	if (font) TTF_CloseFont(font);
+
+	if (num_unchanged > 0) {
+		std::cout << num_unchanged << " segment templates are up to date\n";
+	}
+
+	generate_total = static_cast<int>(GenerateState::jobs.size()) + (GenerateState::holes ? 1 : 0);
+	bGenerating = generate_total > 0;
+	bRedraw = true;
+}
+
+// Call once per frame: redraws the progress and collects the results once every template is done
+void updateGenerate() {
+	if (!bGenerating) return;
+
+	bRedraw = true;
+	if (generate_done < generate_total) return;
+
+	waitForGenerate();
+}
+
+void waitForGenerate() {
+	int saved = 0;
+	for (size_t i = 0; i < GenerateState::jobs.size(); i++) {
+		const auto [id, hash] = GenerateState::job_segments[i];
+		if (GenerateState::jobs[i].valid() && GenerateState::jobs[i].get()) {
+			GenerateState::saved_hashes[id] = hash;
+			saved++;
+		}
+		else {
+			GenerateState::saved_hashes.erase(id);
+		}
+	}
+
+	if (GenerateState::holes_job.valid()) {
+		GenerateState::holes_job.get();
+		finishHoleExport(*GenerateState::holes);
+	}
+	GenerateState::holes.reset();
+
+	if (bGenerating) {
+		std::cout << "Generated " << saved << " of " << GenerateState::jobs.size() << " segment templates in \"" << TEMPLATE_DIRECTORY << "\"\n";
+	}
+
+	GenerateState::jobs.clear();
+	GenerateState::job_segments.clear();
+	bGenerating = false;
+}
+
+float getGenerateProgress() {
+	return generate_total > 0 ? generate_done / static_cast<float>(generate_total) : 0.f;
+}
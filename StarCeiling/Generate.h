@@ -0,0 +1,6 @@
+#pragma once
+
+void startGenerate();
+void updateGenerate();
+void waitForGenerate();
+float getGenerateProgress();
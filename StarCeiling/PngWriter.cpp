@@ -0,0 +1,218 @@
+#include "PngWriter.h"
+
+#include <algorithm>
+#include <array>
+#include <iostream>
+
+// bytes of compressed data per IDAT chunk
+static const size_t IDAT_SIZE = 1 << 16;
+
+static const int BYTES_PER_PIXEL = 3;
+
+// deflate match lengths 3..258, by length code 257..285
+static const int LENGTH_BASE[29] = { 3, 4, 5, 6, 7, 8, 9, 10, 11, 13, 15, 17, 19, 23, 27, 31, 35, 43, 51, 59, 67, 83, 99, 115, 131, 163, 195, 227, 258 };
+static const int LENGTH_EXTRA[29] = { 0, 0, 0, 0, 0, 0, 0, 0, 1, 1, 1, 1, 2, 2, 2, 2, 3, 3, 3, 3, 4, 4, 4, 4, 5, 5, 5, 5, 0 };
+
+static uint32_t crc32(uint32_t crc, const uint8_t* data, size_t size) {
+	static const std::array<uint32_t, 256> table = [] {
+		std::array<uint32_t, 256> t{};
+		for (uint32_t n = 0; n < 256; n++) {
+			uint32_t c = n;
+			for (int k = 0; k < 8; k++) {
+				c = (c & 1) ? 0xEDB88320u ^ (c >> 1) : c >> 1;
+			}
+			t[n] = c;
+		}
+		return t;
+	}();
+
+	crc = ~crc;
+	for (size_t i = 0; i < size; i++) {
+		crc = table[(crc ^ data[i]) & 0xFF] ^ (crc >> 8);
+	}
+	return ~crc;
+}
+
+static void putBigEndian(uint8_t* out, uint32_t value) {
+	out[0] = static_cast<uint8_t>(value >> 24);
+	out[1] = static_cast<uint8_t>(value >> 16);
+	out[2] = static_cast<uint8_t>(value >> 8);
+	out[3] = static_cast<uint8_t>(value);
+}
+
+bool PngWriter::Open(const std::string& filename, int width, int height) {
+	if (width <= 0 || height <= 0) return false;
+
+	file_.open(filename, std::ios::binary | std::ios::trunc);
+	if (!file_.is_open()) {
+		std::cout << "Failed to open " << filename << " for writing\n";
+		return false;
+	}
+
+	width_ = width;
+	height_ = height;
+
+	static const char signature[8] = { '\x89', 'P', 'N', 'G', '\r', '\n', '\x1a', '\n' };
+	file_.write(signature, sizeof(signature));
+	bOk_ = file_.good();
+
+	// 8 bit RGB, not interlaced
+	uint8_t header[13] = {};
+	putBigEndian(header, static_cast<uint32_t>(width));
+	putBigEndian(header + 4, static_cast<uint32_t>(height));
+	header[8] = 8;
+	header[9] = 2;
+	WriteChunk("IHDR", header, sizeof(header));
+
+	// zlib header, then a single final block using the fixed Huffman code
+	row_.resize(1 + static_cast<size_t>(width) * BYTES_PER_PIXEL);
+	idat_.reserve(IDAT_SIZE + 1024);
+	idat_.push_back(0x78);
+	idat_.push_back(0x01);
+	PutBits(1, 1);
+	PutBits(1, 2);
+
+	return bOk_;
+}
+
+bool PngWriter::WriteRow(const uint8_t* rgba) {
+	if (!bOk_ || rows_written_ >= height_) return false;
+
+	// Sub filter: flat areas become runs of zeros
+	row_[0] = 1;
+	uint8_t* out = row_.data() + 1;
+	for (int c = 0; c < BYTES_PER_PIXEL; c++) {
+		out[c] = rgba[c];
+	}
+	for (int x = 1; x < width_; x++) {
+		const uint8_t* pixel = rgba + x * 4;
+		for (int c = 0; c < BYTES_PER_PIXEL; c++) {
+			out[x * BYTES_PER_PIXEL + c] = static_cast<uint8_t>(pixel[c] - pixel[c - 4]);
+		}
+	}
+
+	Deflate(row_.data(), row_.size());
+	rows_written_++;
+
+	if (idat_.size() >= IDAT_SIZE) FlushIdat();
+	return bOk_;
+}
+
+bool PngWriter::Close() {
+	if (!file_.is_open()) return false;
+
+	if (bOk_ && rows_written_ == height_) {
+		// end of block, then pad to a byte
+		PutLiteral(256);
+		if (bit_count_ > 0) {
+			idat_.push_back(static_cast<uint8_t>(bit_buffer_));
+			bit_buffer_ = 0;
+			bit_count_ = 0;
+		}
+
+		uint8_t adler[4];
+		putBigEndian(adler, (adler_b_ << 16) | adler_a_);
+		idat_.insert(idat_.end(), adler, adler + 4);
+		FlushIdat();
+		WriteChunk("IEND", nullptr, 0);
+	}
+	else {
+		bOk_ = false;
+	}
+
+	file_.close();
+	if (file_.fail()) bOk_ = false;
+	return bOk_;
+}
+
+void PngWriter::WriteChunk(const char type[4], const uint8_t* data, size_t size) {
+	uint8_t length[4];
+	putBigEndian(length, static_cast<uint32_t>(size));
+
+	uint32_t crc = crc32(0, reinterpret_cast<const uint8_t*>(type), 4);
+	if (size > 0) crc = crc32(crc, data, size);
+	uint8_t crc_bytes[4];
+	putBigEndian(crc_bytes, crc);
+
+	file_.write(reinterpret_cast<const char*>(length), 4);
+	file_.write(type, 4);
+	if (size > 0) file_.write(reinterpret_cast<const char*>(data), size);
+	file_.write(reinterpret_cast<const char*>(crc_bytes), 4);
+	bOk_ = bOk_ && file_.good();
+}
+
+void PngWriter::FlushIdat() {
+	if (idat_.empty()) return;
+
+	WriteChunk("IDAT", idat_.data(), idat_.size());
+	idat_.clear();
+}
+
+// deflate packs bits starting from the least significant
+void PngWriter::PutBits(uint32_t bits, int count) {
+	bit_buffer_ |= bits << bit_count_;
+	bit_count_ += count;
+	while (bit_count_ >= 8) {
+		idat_.push_back(static_cast<uint8_t>(bit_buffer_));
+		bit_buffer_ >>= 8;
+		bit_count_ -= 8;
+	}
+}
+
+// Huffman codes are packed starting from the most significant bit
+void PngWriter::PutHuffman(uint32_t code, int length) {
+	uint32_t reversed = 0;
+	for (int i = 0; i < length; i++) {
+		reversed = (reversed << 1) | ((code >> i) & 1);
+	}
+	PutBits(reversed, length);
+}
+
+// literal/length symbol of the fixed Huffman code
+void PngWriter::PutLiteral(int value) {
+	if (value < 144) PutHuffman(0x30 + value, 8);
+	else if (value < 256) PutHuffman(0x190 + value - 144, 9);
+	else if (value < 280) PutHuffman(value - 256, 7);
+	else PutHuffman(0xC0 + value - 280, 8);
+}
+
+// repeats the previous byte length times
+void PngWriter::PutMatch(int length) {
+	int code = 28;
+	while (LENGTH_BASE[code] > length) code--;
+
+	PutLiteral(257 + code);
+	PutBits(static_cast<uint32_t>(length - LENGTH_BASE[code]), LENGTH_EXTRA[code]);
+	PutHuffman(0, 5); // distance 1
+}
+
+void PngWriter::Deflate(const uint8_t* data, size_t size) {
+	// checksum of the uncompressed stream, reduced before the sums can overflow
+	for (size_t begin = 0; begin < size; begin += 5552) {
+		const size_t end = std::min(begin + 5552, size);
+		for (size_t i = begin; i < end; i++) {
+			adler_a_ += data[i];
+			adler_b_ += adler_a_;
+		}
+		adler_a_ %= 65521;
+		adler_b_ %= 65521;
+	}
+
+	size_t i = 0;
+	while (i < size) {
+		if (bHasPrevious_) {
+			size_t run = 0;
+			while (i + run < size && run < 258 && data[i + run] == previous_) run++;
+			if (run >= 3) {
+				PutMatch(static_cast<int>(run));
+				i += run;
+				continue;
+			}
+		}
+
+		PutLiteral(data[i]);
+		previous_ = data[i];
+		bHasPrevious_ = true;
+		i++;
+	}
+}
@@ -0,0 +1,57 @@
+#pragma once
+
+#include <stdint.h>
+#include <fstream>
+#include <string>
+#include <vector>
+
+/*
+	Writes an 8 bit RGB PNG one row at a time, so images far larger than memory can be streamed to disk.
+	Rows are Sub filtered and deflated with the fixed Huffman code, emitting runs of repeated bytes as
+	distance 1 matches. That suits the mostly black star layer well and needs no window or history buffer.
+*/
+class PngWriter
+{
+private:
+	std::ofstream file_{};
+	int width_ = 0;
+	int height_ = 0;
+	int rows_written_ = 0;
+	bool bOk_ = false;
+
+	// deflate state
+	uint32_t bit_buffer_ = 0;
+	int bit_count_ = 0;
+	uint32_t adler_a_ = 1;
+	uint32_t adler_b_ = 0;
+	bool bHasPrevious_ = false;
+	uint8_t previous_ = 0;
+
+	std::vector<uint8_t> row_{};		// filtered row, with its filter type byte
+	std::vector<uint8_t> idat_{};		// compressed bytes waiting for the next IDAT chunk
+
+	void WriteChunk(const char type[4], const uint8_t* data, size_t size);
+	void FlushIdat();
+	void PutBits(uint32_t bits, int count);
+	void PutHuffman(uint32_t code, int length);
+	void PutLiteral(int value);
+	void PutMatch(int length);
+	void Deflate(const uint8_t* data, size_t size);
+
+public:
+	PngWriter() = default;
+
+	PngWriter(const PngWriter&) = delete;
+	PngWriter& operator=(const PngWriter&) = delete;
+
+	// Creates the file and writes the header
+	bool Open(const std::string& filename, int width, int height);
+
+	// Appends one row of RGBA32 pixels; alpha is dropped
+	bool WriteRow(const uint8_t* rgba);
+
+	// Ends the stream once every row has been written
+	bool Close();
+
+	bool IsOk() const { return bOk_; }
+};
@@ -0,0 +1,111 @@
+#include "ProjectionCache.h"
+#include "Star.h"
+#include "globals.h"
+#include "utilities.h"
+
+#include <math.h>
+#include <string.h>
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define PROJECTION_SSE2
+#include <emmintrin.h>
+#endif
+
+void ProjectionCache::Rebuild() {
+	stars_.clear();
+	x_n_.clear();
+	y_n_.clear();
+	z_.clear();
+
+	stars_.reserve(stars_by_magnitude.size());
+	x_n_.reserve(stars_by_magnitude.size());
+	y_n_.reserve(stars_by_magnitude.size());
+	z_.reserve(stars_by_magnitude.size());
+
+	for (const auto& star_id : stars_by_magnitude) {
+		auto star_result = universe.find(star_id.first);
+		if (star_result == universe.end() || !star_result->second) continue;
+
+		Star* star = star_result->second.get();
+		const Vector2<float> coords_n = projectToCeiling(star->GetScreenCoords());
+		stars_.push_back(star);
+		x_n_.push_back(coords_n.x);
+		y_n_.push_back(coords_n.y);
+		z_.push_back(star->GetZ());
+	}
+
+	x_px_.resize(stars_.size());
+	y_px_.resize(stars_.size());
+	flags_.resize(stars_.size());
+	bValid_ = true;
+}
+
+void ProjectionCache::Transform(float scale, Vector2<int> pan) {
+	scale_ = scale;
+	offset_ = Vector2<float>(static_cast<float>(ceiling_half.x + pan.x), static_cast<float>(ceiling_half.y + pan.y));
+
+	const size_t count = stars_.size();
+	size_t i = 0;
+
+#ifdef PROJECTION_SSE2
+	const __m128 scale_v = _mm_set1_ps(scale_);
+	const __m128 offset_x = _mm_set1_ps(offset_.x);
+	const __m128 offset_y = _mm_set1_ps(offset_.y);
+	const __m128i zero = _mm_setzero_si128();
+	const __m128i width = _mm_set1_epi32(ceiling_size.x);
+	const __m128i height = _mm_set1_epi32(ceiling_size.y);
+	const __m128i layer_min_x = _mm_set1_epi32(-star_layer_margin.x);
+	const __m128i layer_min_y = _mm_set1_epi32(-star_layer_margin.y);
+	const __m128i layer_max_x = _mm_set1_epi32(ceiling_size.x + star_layer_margin.x);
+	const __m128i layer_max_y = _mm_set1_epi32(ceiling_size.y + star_layer_margin.y);
+	const __m128i flag_ceiling = _mm_set1_epi32(IN_CEILING);
+	const __m128i flag_layer = _mm_set1_epi32(IN_LAYER);
+
+	for (; i + 4 <= count; i += 4) {
+		const __m128i x = _mm_cvtps_epi32(_mm_add_ps(_mm_mul_ps(_mm_loadu_ps(&x_n_[i]), scale_v), offset_x));
+		const __m128i y = _mm_cvtps_epi32(_mm_add_ps(_mm_mul_ps(_mm_loadu_ps(&y_n_[i]), scale_v), offset_y));
+		_mm_storeu_si128(reinterpret_cast<__m128i*>(&x_px_[i]), x);
+		_mm_storeu_si128(reinterpret_cast<__m128i*>(&y_px_[i]), y);
+
+		const __m128i above_horizon = _mm_castps_si128(_mm_cmpgt_ps(_mm_loadu_ps(&z_[i]), _mm_setzero_ps()));
+
+		__m128i in_ceiling = _mm_and_si128(_mm_cmpgt_epi32(x, zero), _mm_cmplt_epi32(x, width));
+		in_ceiling = _mm_and_si128(in_ceiling, _mm_and_si128(_mm_cmpgt_epi32(y, zero), _mm_cmplt_epi32(y, height)));
+
+		__m128i in_layer = _mm_and_si128(_mm_cmpgt_epi32(x, layer_min_x), _mm_cmplt_epi32(x, layer_max_x));
+		in_layer = _mm_and_si128(in_layer, _mm_and_si128(_mm_cmpgt_epi32(y, layer_min_y), _mm_cmplt_epi32(y, layer_max_y)));
+
+		__m128i flags = _mm_or_si128(_mm_and_si128(in_ceiling, flag_ceiling), _mm_and_si128(in_layer, flag_layer));
+		flags = _mm_and_si128(flags, above_horizon);
+
+		// narrow the four 32 bit flags to bytes
+		flags = _mm_packus_epi16(_mm_packs_epi32(flags, zero), zero);
+		const int packed = _mm_cvtsi128_si32(flags);
+		memcpy(&flags_[i], &packed, 4);
+	}
+#endif
+
+	for (; i < count; i++) {
+		const int x = static_cast<int>(lrintf(x_n_[i] * scale_ + offset_.x));
+		const int y = static_cast<int>(lrintf(y_n_[i] * scale_ + offset_.y));
+		x_px_[i] = x;
+		y_px_[i] = y;
+
+		uint8_t flags = 0;
+		if (z_[i] > 0.f) {
+			if (x > 0 && x < ceiling_size.x && y > 0 && y < ceiling_size.y) flags |= IN_CEILING;
+			if (x > -star_layer_margin.x && x < ceiling_size.x + star_layer_margin.x
+				&& y > -star_layer_margin.y && y < ceiling_size.y + star_layer_margin.y) flags |= IN_LAYER;
+		}
+		flags_[i] = flags;
+	}
+
+	// stars over parts of the ceiling excluded by its outline are dropped before any selection
+	if (!ceiling_mask.IsRectangular()) {
+		for (size_t row = 0; row < count; row++) {
+			if ((flags_[row] & IN_CEILING) != 0 && !ceiling_mask.Contains(x_px_[row], y_px_[row])) {
+				flags_[row] = 0;
+			}
+		}
+	}
+}
@@ -0,0 +1,57 @@
+#pragma once
+
+#include <vector>
+#include <stdint.h>
+#include "types.h"
+
+class Star;
+
+/*
+	Normalized screen coordinates of every star, in stars_by_magnitude order, turned to the ceiling's
+	orientation and mapped onto its surface, stored as flat arrays. They only change when the stars are
+	transformed; zooming and panning is a single scale-and-offset pass over the arrays that produces
+	integer pixel coordinates and in-bounds flags for every star.
+*/
+class ProjectionCache
+{
+public:
+	// per star flags written by Transform()
+	static const uint8_t IN_CEILING = 1 << 0;
+	static const uint8_t IN_LAYER = 1 << 1;
+
+private:
+	std::vector<Star*> stars_{};
+	std::vector<float> x_n_{};
+	std::vector<float> y_n_{};
+	std::vector<float> z_{};
+	std::vector<int> x_px_{};
+	std::vector<int> y_px_{};
+	std::vector<uint8_t> flags_{};
+	bool bValid_ = false;
+
+	// transform of the last pass
+	float scale_ = 1.f;
+	Vector2<float> offset_{ 0.f, 0.f };
+
+public:
+	// Rows are rebuilt from the catalog on the next selection
+	void Invalidate() { bValid_ = false; }
+	bool IsValid() const { return bValid_; }
+	void Rebuild();
+
+	/*
+		Scales the normalized coordinates and adds the offset (ceiling centre plus pan), producing ceiling
+		relative pixel coordinates and IN_CEILING / IN_LAYER flags.
+	*/
+	void Transform(float scale, Vector2<int> pan);
+
+	size_t Size() const { return stars_.size(); }
+	Star* GetStar(size_t row) const { return stars_[row]; }
+	uint8_t GetFlags(size_t row) const { return flags_[row]; }
+	Vector2<int> GetScreenCoords(size_t row) const { return Vector2<int>(x_px_[row], y_px_[row]); }
+
+	// sub-pixel coordinates under the last transform
+	Vector2<float> GetScreenCoordsF(size_t row) const {
+		return Vector2<float>(x_n_[row] * scale_ + offset_.x, y_n_[row] * scale_ + offset_.y);
+	}
+};
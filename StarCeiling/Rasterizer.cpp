@@ -0,0 +1,238 @@
+#include "Rasterizer.h"
+#include "ThreadPool.h"
+
+#include <math.h>
+#include <algorithm>
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define RASTERIZER_SSE2
+#include <emmintrin.h>
+#endif
+
+// PSF footprint in standard deviations
+static const float SPLAT_EXTENT = 3.f;
+
+void Rasterizer::Resize(int width, int height) {
+	if (width == width_ && height == height_) return;
+
+	width_ = std::max(width, 0);
+	height_ = std::max(height, 0);
+	accum_.assign(static_cast<size_t>(width_) * height_ * 4, 0.f);
+	splats_.clear();
+}
+
+void Rasterizer::Clear() {
+	std::fill(accum_.begin(), accum_.end(), 0.f);
+	splats_.clear();
+}
+
+void Rasterizer::AddStar(Vector2<float> position, float radius, RGB colour, uint8_t brightness) {
+	Splat splat;
+	splat.x = position.x;
+	splat.y = position.y;
+	splat.sigma = std::max(radius, 0.5f) * 0.85f;
+
+	const float amplitude = brightness / 255.f;
+	splat.colour[0] = colour.R / 255.f * amplitude;
+	splat.colour[1] = colour.G / 255.f * amplitude;
+	splat.colour[2] = colour.B / 255.f * amplitude;
+	splat.colour[3] = amplitude;
+	splats_.push_back(splat);
+}
+
+void Rasterizer::Rasterize(ThreadPool* pool) {
+	const int bands = (height_ + BAND_HEIGHT - 1) / BAND_HEIGHT;
+	auto rasterize_band = [this](int band) {
+		RasterizeRows(band * BAND_HEIGHT, std::min((band + 1) * BAND_HEIGHT, height_));
+	};
+
+	if (pool) {
+		pool->ParallelFor(bands, rasterize_band);
+	}
+	else {
+		for (int band = 0; band < bands; band++) rasterize_band(band);
+	}
+
+	splats_.clear();
+}
+
+/*
+	Splats every star overlapping the given rows. The gaussian is separable, so the horizontal and vertical
+	weights are computed once per star and each pixel is a single multiply-add of the RGBA vector.
+*/
+void Rasterizer::RasterizeRows(int row_begin, int row_end) {
+	static const int MAX_FOOTPRINT = 64;
+	float weights_x[MAX_FOOTPRINT];
+
+	for (const Splat& splat : splats_) {
+		const float reach = std::min(SPLAT_EXTENT * splat.sigma, MAX_FOOTPRINT / 2.f - 1.f);
+		const int y0 = std::max(static_cast<int>(floorf(splat.y - reach)), row_begin);
+		const int y1 = std::min(static_cast<int>(ceilf(splat.y + reach)), row_end - 1);
+		if (y0 > y1) continue;
+
+		const int x0 = std::max(static_cast<int>(floorf(splat.x - reach)), 0);
+		const int x1 = std::min(static_cast<int>(ceilf(splat.x + reach)), width_ - 1);
+		if (x0 > x1) continue;
+
+		const float inv_two_sigma_sq = 1.f / (2.f * splat.sigma * splat.sigma);
+		for (int x = x0; x <= x1; x++) {
+			const float dx = x + 0.5f - splat.x;
+			weights_x[x - x0] = expf(-dx * dx * inv_two_sigma_sq);
+		}
+
+		for (int y = y0; y <= y1; y++) {
+			const float dy = y + 0.5f - splat.y;
+			const float weight_y = expf(-dy * dy * inv_two_sigma_sq);
+			float* row = accum_.data() + (static_cast<size_t>(y) * width_ + x0) * 4;
+
+#ifdef RASTERIZER_SSE2
+			const __m128 colour = _mm_mul_ps(_mm_loadu_ps(splat.colour), _mm_set1_ps(weight_y));
+			for (int i = 0; i <= x1 - x0; i++) {
+				__m128 pixel = _mm_loadu_ps(row + i * 4);
+				pixel = _mm_add_ps(pixel, _mm_mul_ps(colour, _mm_set1_ps(weights_x[i])));
+				_mm_storeu_ps(row + i * 4, pixel);
+			}
+#else
+			for (int i = 0; i <= x1 - x0; i++) {
+				const float weight = weights_x[i] * weight_y;
+				for (int c = 0; c < 4; c++) {
+					row[i * 4 + c] += splat.colour[c] * weight;
+				}
+			}
+#endif
+		}
+	}
+}
+
+void Rasterizer::AddPixel(int x, int y, const float colour[4]) {
+	if (x < 0 || y < 0 || x >= width_ || y >= height_) return;
+
+	float* pixel = accum_.data() + (static_cast<size_t>(y) * width_ + x) * 4;
+	for (int c = 0; c < 4; c++) {
+		pixel[c] += colour[c];
+	}
+}
+
+/*
+	Draws a line by stepping along its major axis and splitting each step between the two nearest pixels on
+	the minor axis.
+*/
+void Rasterizer::AddLine(Vector2<float> start, Vector2<float> end, RGBA colour) {
+	const float alpha = colour.A / 255.f;
+	const float base[4] = { colour.R / 255.f * alpha, colour.G / 255.f * alpha, colour.B / 255.f * alpha, alpha };
+
+	const float dx = end.x - start.x;
+	const float dy = end.y - start.y;
+	const bool steep = fabsf(dy) > fabsf(dx);
+	const float length = std::max(fabsf(dx), fabsf(dy));
+	const int steps = static_cast<int>(ceilf(length));
+	if (steps == 0) {
+		AddPixel(static_cast<int>(start.x), static_cast<int>(start.y), base);
+		return;
+	}
+
+	const float step_x = dx / steps;
+	const float step_y = dy / steps;
+	for (int i = 0; i <= steps; i++) {
+		const float x = start.x + step_x * i;
+		const float y = start.y + step_y * i;
+		const float minor = steep ? x - 0.5f : y - 0.5f;
+		const float minor_floor = floorf(minor);
+		const float frac = minor - minor_floor;
+
+		float near_colour[4];
+		float far_colour[4];
+		for (int c = 0; c < 4; c++) {
+			near_colour[c] = base[c] * (1.f - frac);
+			far_colour[c] = base[c] * frac;
+		}
+
+		if (steep) {
+			AddPixel(static_cast<int>(minor_floor), static_cast<int>(y), near_colour);
+			AddPixel(static_cast<int>(minor_floor) + 1, static_cast<int>(y), far_colour);
+		}
+		else {
+			AddPixel(static_cast<int>(x), static_cast<int>(minor_floor), near_colour);
+			AddPixel(static_cast<int>(x), static_cast<int>(minor_floor) + 1, far_colour);
+		}
+	}
+}
+
+void Rasterizer::AddRect(int x, int y, int width, int height, RGBA colour) {
+	const float alpha = colour.A / 255.f;
+	const float base[4] = { colour.R / 255.f * alpha, colour.G / 255.f * alpha, colour.B / 255.f * alpha, alpha };
+
+	const int x_end = std::min(x + width, width_);
+	const int y_end = std::min(y + height, height_);
+	for (int row = std::max(y, 0); row < y_end; row++) {
+		for (int col = std::max(x, 0); col < x_end; col++) {
+			AddPixel(col, row, base);
+		}
+	}
+}
+
+void Rasterizer::AddImage(int x, int y, int width, int height, const uint8_t* pixels, int pitch) {
+	for (int row = 0; row < height; row++) {
+		const uint8_t* src = pixels + static_cast<size_t>(row) * pitch;
+		for (int col = 0; col < width; col++, src += 4) {
+			const float alpha = src[3] / 255.f;
+			if (alpha == 0.f) continue;
+
+			const float colour[4] = { src[0] / 255.f * alpha, src[1] / 255.f * alpha, src[2] / 255.f * alpha, alpha };
+			AddPixel(x + col, y + row, colour);
+		}
+	}
+}
+
+void Rasterizer::Resolve(uint8_t* pixels, int pitch, ThreadPool* pool) {
+	const int bands = (height_ + BAND_HEIGHT - 1) / BAND_HEIGHT;
+	auto resolve_band = [this, pixels, pitch](int band) {
+		ResolveRows(band * BAND_HEIGHT, std::min((band + 1) * BAND_HEIGHT, height_), pixels, pitch);
+	};
+
+	if (pool) {
+		pool->ParallelFor(bands, resolve_band);
+	}
+	else {
+		for (int band = 0; band < bands; band++) resolve_band(band);
+	}
+}
+
+// Saturates the accumulated colour to 8 bits per channel over an opaque black background
+void Rasterizer::ResolveRows(int row_begin, int row_end, uint8_t* pixels, int pitch) {
+	for (int y = row_begin; y < row_end; y++) {
+		float* source = accum_.data() + static_cast<size_t>(y) * width_ * 4;
+		uint8_t* dest = pixels + static_cast<size_t>(y) * pitch;
+
+#ifdef RASTERIZER_SSE2
+		const __m128 scale = _mm_set1_ps(255.f);
+		const __m128 zero = _mm_setzero_ps();
+		const __m128i opaque = _mm_set1_epi32(static_cast<int>(0xFF000000));
+		int x = 0;
+		for (; x + 4 <= width_; x += 4) {
+			// four pixels at a time: float -> int32 -> saturated int16 -> saturated uint8
+			__m128i p0 = _mm_cvtps_epi32(_mm_mul_ps(_mm_loadu_ps(source + x * 4 + 0), scale));
+			__m128i p1 = _mm_cvtps_epi32(_mm_mul_ps(_mm_loadu_ps(source + x * 4 + 4), scale));
+			__m128i p2 = _mm_cvtps_epi32(_mm_mul_ps(_mm_loadu_ps(source + x * 4 + 8), scale));
+			__m128i p3 = _mm_cvtps_epi32(_mm_mul_ps(_mm_loadu_ps(source + x * 4 + 12), scale));
+			__m128i packed = _mm_packus_epi16(_mm_packs_epi32(p0, p1), _mm_packs_epi32(p2, p3));
+			_mm_storeu_si128(reinterpret_cast<__m128i*>(dest + x * 4), _mm_or_si128(packed, opaque));
+
+			_mm_storeu_ps(source + x * 4 + 0, zero);
+			_mm_storeu_ps(source + x * 4 + 4, zero);
+			_mm_storeu_ps(source + x * 4 + 8, zero);
+			_mm_storeu_ps(source + x * 4 + 12, zero);
+		}
+#else
+		int x = 0;
+#endif
+		for (; x < width_; x++) {
+			for (int c = 0; c < 3; c++) {
+				dest[x * 4 + c] = static_cast<uint8_t>(std::clamp(source[x * 4 + c] * 255.f + 0.5f, 0.f, 255.f));
+				source[x * 4 + c] = 0.f;
+			}
+			dest[x * 4 + 3] = UINT8_MAX;
+			source[x * 4 + 3] = 0.f;
+		}
+	}
+}
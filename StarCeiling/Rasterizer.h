@@ -0,0 +1,60 @@
+#pragma once
+
+#include <vector>
+#include <stdint.h>
+#include "types.h"
+
+class ThreadPool;
+
+/*
+	CPU star rasterizer. Stars are splatted as gaussian point spread functions at sub-pixel positions and
+	accumulated additively into a floating point RGBA buffer, which is then resolved to 8 bit RGBA pixels.
+	Used where the SDL renderer falls back to software and per-primitive overhead dominates.
+*/
+class Rasterizer
+{
+private:
+	struct Splat {
+		float x = 0.f;
+		float y = 0.f;
+		float sigma = 0.f;
+		float colour[4] = { 0.f, 0.f, 0.f, 0.f }; // RGBA, scaled by brightness
+	};
+
+	int width_ = 0;
+	int height_ = 0;
+	std::vector<float> accum_{}; // 4 floats per pixel
+	std::vector<Splat> splats_{};
+
+	void RasterizeRows(int row_begin, int row_end);
+	void ResolveRows(int row_begin, int row_end, uint8_t* pixels, int pitch);
+	void AddPixel(int x, int y, const float colour[4]);
+
+public:
+	// number of rows handed to a thread at a time
+	static const int BAND_HEIGHT = 32;
+
+	void Resize(int width, int height);
+	int GetWidth() const { return width_; }
+	int GetHeight() const { return height_; }
+
+	// Queues a star; it is drawn by the next Rasterize()
+	void AddStar(Vector2<float> position, float radius, RGB colour, uint8_t brightness);
+
+	// Draws an anti-aliased line directly into the buffer, blended additively
+	void AddLine(Vector2<float> start, Vector2<float> end, RGBA colour);
+
+	// Fills a rectangle, blended additively
+	void AddRect(int x, int y, int width, int height, RGBA colour);
+
+	// Adds RGBA32 pixels weighted by their alpha, e.g. rendered text
+	void AddImage(int x, int y, int width, int height, const uint8_t* pixels, int pitch);
+
+	// Splats all queued stars, one band of rows per task
+	void Rasterize(ThreadPool* pool);
+
+	// Converts the buffer to RGBA32 pixels and clears it for the next frame
+	void Resolve(uint8_t* pixels, int pitch, ThreadPool* pool);
+
+	void Clear();
+};
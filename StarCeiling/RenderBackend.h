@@ -0,0 +1,34 @@
+#pragma once
+
+#include <vector>
+#include "types.h"
+
+#pragma warning(push, 0)
+#include "SDL.h"
+#pragma warning(pop)
+#undef main
+
+/*
+	Drawing interface behind the functions in graphics.h. SdlBackend draws through the SDL renderer into the
+	window and textures; FramebufferBackend draws into an in-memory image on the CPU and needs no window
+	system.
+*/
+class RenderBackend
+{
+public:
+	virtual ~RenderBackend() = default;
+
+	// Primitives, in pixels of the current target
+	virtual bool DrawLine(Vector2<float> start, Vector2<float> end, const RGBA& colour) = 0;
+	virtual bool DrawPolylines(const Polylines& lines, const RGBA& colour) = 0;
+	virtual bool DrawRect(Vector2<int> start, Vector2<int> size, const RGBA& colour) = 0;
+	virtual bool FillRect(Vector2<int> start, Vector2<int> size, const RGBA& colour) = 0;
+
+	// Draws an image (e.g. rendered text) with its top left corner at position
+	virtual bool DrawSurface(SDL_Surface* surface, Vector2<int> position) = 0;
+
+	// Everything drawn between BeginStarLayer() and EndStarLayer() lands in the star layer
+	virtual bool BeginStarLayer(Vector2<int> size) = 0;
+	virtual void DrawStars(const std::vector<SelectedStar>& stars, RenderQuality quality) = 0;
+	virtual void EndStarLayer() = 0;
+};
@@ -0,0 +1,169 @@
+#include "SdlBackend.h"
+#include "globals.h"
+#include "graphics.h"
+#include <math.h>
+#include <iostream>
+
+// integer draw calls address pixels, the software rasterizer addresses pixel edges
+static const float PIXEL_CENTRE = 0.5f;
+
+bool SdlBackend::CheckError(int ret, const char* function) {
+	// error handling
+	if (ret != 0)
+	{
+		const char* error = SDL_GetError();
+		if (*error != '\0')
+		{
+			SDL_LogError(SDL_LOG_CATEGORY_APPLICATION, "Could not %s. SDL Error: %s at line #%d of file %s/n", function, error, __LINE__, __FILE__);
+			SDL_ClearError();
+		}
+		return false;
+	}
+
+	return true;
+}
+
+bool SdlBackend::DrawLine(Vector2<float> start, Vector2<float> end, const RGBA& colour) {
+	if (bInStarLayer_ && bUseSoftwareRasterizer && software_rasterizer) {
+		software_rasterizer->AddLine(
+			Vector2<float>(start.x + PIXEL_CENTRE, start.y + PIXEL_CENTRE),
+			Vector2<float>(end.x + PIXEL_CENTRE, end.y + PIXEL_CENTRE),
+			colour);
+		return true;
+	}
+
+	setDrawColor(colour);
+
+	// Draw a line
+	//---
+	int ret = SDL_RenderDrawLine(
+		Environment::renderer, // SDL_Renderer* renderer: the renderer in which draw
+		static_cast<int>(round(start.x)),               // int x1: x of the starting point
+		static_cast<int>(round(start.y)),          // int y1: y of the starting point
+		static_cast<int>(round(end.x)),                 // int x2: x of the end point
+		static_cast<int>(round(end.y)));           // int y2: y of the end point
+
+	return CheckError(ret, "renderDrawLine");
+}
+
+// one draw call per strip
+bool SdlBackend::DrawPolylines(const Polylines& lines, const RGBA& colour) {
+	if (bInStarLayer_ && bUseSoftwareRasterizer && software_rasterizer) {
+		int start = 0;
+		for (int end : lines.ends) {
+			for (int i = start + 1; i < end; i++) {
+				software_rasterizer->AddLine(
+					Vector2<float>(lines.points[i - 1].x + PIXEL_CENTRE, lines.points[i - 1].y + PIXEL_CENTRE),
+					Vector2<float>(lines.points[i].x + PIXEL_CENTRE, lines.points[i].y + PIXEL_CENTRE),
+					colour);
+			}
+			start = end;
+		}
+		return true;
+	}
+
+	setDrawColor(colour);
+
+	std::vector<SDL_FPoint> points;
+	points.reserve(lines.points.size());
+	for (const auto& point : lines.points) {
+		points.push_back(SDL_FPoint{ point.x, point.y });
+	}
+
+	bool bSuccess = true;
+	int start = 0;
+	for (int end : lines.ends) {
+		bSuccess &= CheckError(SDL_RenderDrawLinesF(Environment::renderer, points.data() + start, end - start), "renderDrawLines");
+		start = end;
+	}
+	return bSuccess;
+}
+
+bool SdlBackend::DrawRect(Vector2<int> start, Vector2<int> size, const RGBA& colour) {
+	SDL_Rect rect = SDL_Rect{ start.x, start.y, size.x, size.y };
+	setDrawColor(colour);
+	return CheckError(SDL_RenderDrawRect(Environment::renderer, &rect), "renderRect");
+}
+
+bool SdlBackend::FillRect(Vector2<int> start, Vector2<int> size, const RGBA& colour) {
+	SDL_Rect rect = SDL_Rect{ start.x, start.y, size.x, size.y };
+	setDrawColor(colour);
+	return CheckError(SDL_RenderFillRect(Environment::renderer, &rect), "renderFillRect");
+}
+
+bool SdlBackend::DrawSurface(SDL_Surface* surface, Vector2<int> position) {
+	SDL_Texture* texture = SDL_CreateTextureFromSurface(Environment::renderer, surface);
+	if (!texture) {
+		std::cout << "Failed to create texture from surface: " << SDL_GetError() << "\n";
+		return false;
+	}
+
+	SDL_Rect dest = SDL_Rect{ position.x, position.y, surface->w, surface->h };
+	int ret = SDL_RenderCopy(Environment::renderer, texture, NULL, &dest);
+	SDL_DestroyTexture(texture);
+	return CheckError(ret, "renderCopy");
+}
+
+bool SdlBackend::BeginStarLayer(Vector2<int> size) {
+	if (!createStarTexture()) return false;
+
+	if (bUseSoftwareRasterizer) {
+		if (!software_rasterizer) return false;
+		software_rasterizer->Resize(size.x, size.y);
+		bInStarLayer_ = true;
+		return true;
+	}
+
+	if (!star_sprites[static_cast<size_t>(StarSize::SMALL)] && !createStarSprites()) {
+		return false;
+	}
+
+	// draw to the texture
+	if (!setRenderTarget(star_texture)) return false;
+
+	// fill surface with black
+	setDrawColor(RGBA{ 0, 0, 0, SDL_ALPHA_OPAQUE });
+	SDL_RenderFillRect(Environment::renderer, NULL);
+
+	bInStarLayer_ = true;
+	return true;
+}
+
+void SdlBackend::DrawStars(const std::vector<SelectedStar>& stars, RenderQuality quality) {
+	if (bUseSoftwareRasterizer) {
+		for (const auto& star : stars) {
+			software_rasterizer->AddStar(star.position, getStarRadius(star.size), star.colour, star.brightness);
+		}
+		return;
+	}
+
+	if (quality == RenderQuality::DRAFT) {
+		renderStarPoints(stars);
+	}
+	else {
+		// draw all stars in one sprite pass
+		renderStarSprites(stars);
+	}
+}
+
+/*
+	Software path: splats the queued stars on the CPU, then uploads the pixels to the streaming star texture
+	in one go.
+*/
+void SdlBackend::EndStarLayer() {
+	bInStarLayer_ = false;
+	if (!bUseSoftwareRasterizer) return;
+
+	software_rasterizer->Rasterize(thread_pool.get());
+
+	void* pixels = nullptr;
+	int pitch = 0;
+	if (SDL_LockTexture(star_texture, NULL, &pixels, &pitch) != 0) {
+		std::cout << "Error locking star texture: " << SDL_GetError() << "\n";
+		software_rasterizer->Clear();
+		return;
+	}
+
+	software_rasterizer->Resolve(static_cast<uint8_t*>(pixels), pitch, thread_pool.get());
+	SDL_UnlockTexture(star_texture);
+}
@@ -0,0 +1,26 @@
+#pragma once
+
+#include "RenderBackend.h"
+
+/*
+	Draws through Environment::renderer. The star layer is star_texture, drawn either with the renderer or,
+	with bUseSoftwareRasterizer, splatted by software_rasterizer and uploaded once per frame.
+*/
+class SdlBackend : public RenderBackend
+{
+private:
+	bool bInStarLayer_ = false;
+
+	bool CheckError(int ret, const char* function);
+
+public:
+	bool DrawLine(Vector2<float> start, Vector2<float> end, const RGBA& colour) override;
+	bool DrawPolylines(const Polylines& lines, const RGBA& colour) override;
+	bool DrawRect(Vector2<int> start, Vector2<int> size, const RGBA& colour) override;
+	bool FillRect(Vector2<int> start, Vector2<int> size, const RGBA& colour) override;
+	bool DrawSurface(SDL_Surface* surface, Vector2<int> position) override;
+
+	bool BeginStarLayer(Vector2<int> size) override;
+	void DrawStars(const std::vector<SelectedStar>& stars, RenderQuality quality) override;
+	void EndStarLayer() override;
+};
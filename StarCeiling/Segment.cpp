@@ -1,75 +1,224 @@
 #include "Segment.h"
 #include "globals.h"
+#include "graphics.h"
+#include "utilities.h"
+#include <algorithm>
 #include <iostream>
 
-Segment::Segment(int id, Vector2<int> coordinates) : id_{ id }, coords_{ coordinates }{}
+// marker dimensions, in hole radii
+static const float MARKER_RING_SCALE = 4.f;
+static const float MARKER_CROSS_SCALE = 6.f;
+static const float MIN_HOLE_RADIUS_PX = 1.5f;
+
+// north marker, in mm
+static const float NORTH_MARKER_HEIGHT_MM = 20.f;
+
+// FNV-1a
+static const uint64_t HASH_OFFSET = 14695981039346656037ull;
+static const uint64_t HASH_PRIME = 1099511628211ull;
+
+static uint64_t hashValue(uint64_t hash, uint32_t value) {
+	for (int i = 0; i < 4; i++) {
+		hash = (hash ^ ((value >> (i * 8)) & 0xFF)) * HASH_PRIME;
+	}
+	return hash;
+}
+
+static uint64_t hashStar(uint64_t hash, const Segment::StarData& star) {
+	hash = hashValue(hash, static_cast<uint32_t>(star.id));
+	hash = hashValue(hash, static_cast<uint32_t>(lroundf(star.screen_coords.x * HASH_POSITION_STEPS)));
+	hash = hashValue(hash, static_cast<uint32_t>(lroundf(star.screen_coords.y * HASH_POSITION_STEPS)));
+	return hashValue(hash, static_cast<uint32_t>(star.star_size));
+}
+
+Segment::Segment(int id, Vector2<int> coordinates, Vector2<float> origin_mm, Vector2<float> size_mm)
+	: id_{ id }, coords_{ coordinates }, origin_mm_{ origin_mm }, size_mm_{ size_mm }, hash_{ HASH_OFFSET } {}
 
 void Segment::AddStar(int id, Vector2<float> screen_coordinates, StarSize size) {
 	star_data_.push_back(StarData(id, screen_coordinates, size));
+	hash_ = hashStar(hash_, star_data_.back());
 }
 
 void Segment::ClearStars() {
 	star_data_.clear();
+	hash_ = HASH_OFFSET;
+}
+
+bool Segment::SetStars(const std::vector<StarData>& stars) {
+	const uint64_t hash = HashStars(stars);
+	if (hash == hash_ && stars.size() == star_data_.size()) return false;
+
+	star_data_.assign(stars.begin(), stars.end());
+	hash_ = hash;
+	return true;
 }
 
-// Texture
-SDL_Texture* Segment::CreateTexture() {
-	SDL_Texture* segment_texture = nullptr;
+uint64_t Segment::HashStars(const std::vector<StarData>& stars) {
+	uint64_t hash = HASH_OFFSET;
+	for (const auto& star : stars) {
+		hash = hashStar(hash, star);
+	}
+	return hash;
+}
+
+// one row of pixels from x_start to x_end, clipped to the surface
+static void fillSpan(SDL_Surface* surface, int y, float x_start, float x_end, Uint32 colour) {
+	const int x0 = std::max(static_cast<int>(ceilf(x_start - 0.5f)), 0);
+	const int x1 = std::min(static_cast<int>(floorf(x_end - 0.5f)), surface->w - 1);
+	if (y < 0 || y >= surface->h || x1 < x0) return;
 
-	// save renderers target
-	SDL_Texture* target = SDL_GetRenderTarget(Environment::renderer);
+	SDL_Rect span = SDL_Rect{ x0, y, x1 - x0 + 1, 1 };
+	SDL_FillRect(surface, &span, colour);
+}
 
-	// determine segment size
-	int segment_size = std::min(ceiling_size.x, ceiling_size.y);
+static void fillCircle(SDL_Surface* surface, Vector2<float> center, float radius, Uint32 colour) {
+	const int y0 = static_cast<int>(floorf(center.y - radius));
+	const int y1 = static_cast<int>(ceilf(center.y + radius));
+	for (int y = y0; y <= y1; y++) {
+		const float dy = y + 0.5f - center.y;
+		if (fabsf(dy) > radius) continue;
 
-	// create texture
-	segment_texture = SDL_CreateTexture(Environment::renderer, SDL_PIXELFORMAT_RGBA8888, SDL_TEXTUREACCESS_TARGET, segment_size, segment_size);
-	if (!segment_texture) {
-		std::cout << "Error creating star texture: " << SDL_GetError() << "\n";
-		SDL_SetRenderTarget(Environment::renderer, target);
-		return nullptr;
+		const float half = sqrtf(radius * radius - dy * dy);
+		fillSpan(surface, y, center.x - half, center.x + half, colour);
+	}
+}
+
+static void drawRing(SDL_Surface* surface, Vector2<float> center, float radius, float thickness, Uint32 colour) {
+	const float inner = std::max(radius - thickness, 0.f);
+	const int y0 = static_cast<int>(floorf(center.y - radius));
+	const int y1 = static_cast<int>(ceilf(center.y + radius));
+	for (int y = y0; y <= y1; y++) {
+		const float dy = y + 0.5f - center.y;
+		if (fabsf(dy) > radius) continue;
+
+		const float outer_half = sqrtf(radius * radius - dy * dy);
+		if (fabsf(dy) >= inner) {
+			fillSpan(surface, y, center.x - outer_half, center.x + outer_half, colour);
+			continue;
+		}
+
+		const float inner_half = sqrtf(inner * inner - dy * dy);
+		fillSpan(surface, y, center.x - outer_half, center.x - inner_half, colour);
+		fillSpan(surface, y, center.x + inner_half, center.x + outer_half, colour);
+	}
+}
+
+static void drawCross(SDL_Surface* surface, Vector2<float> center, float half_length, int thickness, Uint32 colour) {
+	const int cx = static_cast<int>(center.x);
+	const int cy = static_cast<int>(center.y);
+	const int length = static_cast<int>(half_length);
+	SDL_Rect horizontal = SDL_Rect{ cx - length, cy - thickness / 2, length * 2 + 1, thickness };
+	SDL_Rect vertical = SDL_Rect{ cx - thickness / 2, cy - length, thickness, length * 2 + 1 };
+	SDL_FillRect(surface, &horizontal, colour);
+	SDL_FillRect(surface, &vertical, colour);
+}
+
+// arrow around center pointing north, angle in radians clockwise from the top edge
+static void drawNorthMarker(SDL_Surface* surface, Vector2<float> center, float height, float angle, Uint32 colour) {
+	const Vector2<float> forward(sinf(angle) * height / 2.f, -cosf(angle) * height / 2.f);
+	const Vector2<float> side(cosf(angle) * height * 0.3f, sinf(angle) * height * 0.3f);
+	const Vector2<float> corners[3] = {
+		Vector2<float>(center.x + forward.x, center.y + forward.y),
+		Vector2<float>(center.x - forward.x - side.x, center.y - forward.y - side.y),
+		Vector2<float>(center.x - forward.x + side.x, center.y - forward.y + side.y)
+	};
+
+	// fill row by row between the edges crossing the row's centre
+	const float top = std::min({ corners[0].y, corners[1].y, corners[2].y });
+	const float bottom = std::max({ corners[0].y, corners[1].y, corners[2].y });
+	for (int y = static_cast<int>(floorf(top)); y <= static_cast<int>(ceilf(bottom)); y++) {
+		const float row = y + 0.5f;
+		float left = INFINITY, right = -INFINITY;
+		for (int i = 0; i < 3; i++) {
+			const Vector2<float>& a = corners[i];
+			const Vector2<float>& b = corners[(i + 1) % 3];
+			if ((row < a.y) == (row < b.y)) continue;
+			const float x = a.x + (row - a.y) / (b.y - a.y) * (b.x - a.x);
+			left = std::min(left, x);
+			right = std::max(right, x);
+		}
+		if (left <= right) fillSpan(surface, y, left, right, colour);
 	}
+}
 
+static float getHoleRadius(StarSize size) {
+	switch (size) {
+	case StarSize::LARGE:
+		return star_hole_diameter_large / 2.f;
+	case StarSize::MEDIUM:
+		return star_hole_diameter_medium / 2.f;
+	default:
+		return star_hole_diameter_small / 2.f;
+	}
+}
+
+SDL_Surface* Segment::CreateTemplate(float px_per_mm, float north, SDL_Surface* label) const {
+	const int width = static_cast<int>(lroundf(size_mm_.x * px_per_mm));
+	const int height = static_cast<int>(lroundf(size_mm_.y * px_per_mm));
+	if (width <= 0 || height <= 0) return nullptr;
+
+	SDL_Surface* surface = SDL_CreateRGBSurfaceWithFormat(0, width, height, 32, SDL_PIXELFORMAT_RGBA32);
+	if (!surface) {
+		std::cout << "Error creating template for segment " << id_ << ": " << SDL_GetError() << "\n";
+		return nullptr;
+	}
 
-	// set the texture as a target
-	SDL_SetRenderTarget(Environment::renderer, star_texture);
+	const Uint32 white = SDL_MapRGBA(surface->format, 255, 255, 255, SDL_ALPHA_OPAQUE);
+	const Uint32 black = SDL_MapRGBA(surface->format, 0, 0, 0, SDL_ALPHA_OPAQUE);
+	const Uint32 grey = SDL_MapRGBA(surface->format, 160, 160, 160, SDL_ALPHA_OPAQUE);
+	const int line_width = std::max(1, static_cast<int>(px_per_mm * 0.5f));
 
 	// fill surface with white
-	SDL_SetRenderDrawColor(Environment::renderer, 255, 255, 255, SDL_ALPHA_OPAQUE);
-	SDL_RenderFillRect(Environment::renderer, NULL);
+	SDL_FillRect(surface, NULL, white);
 
-	// draw stars
+	// outline, to align the template with the panel
+	SDL_Rect edges[4] = {
+		SDL_Rect{ 0, 0, width, line_width },
+		SDL_Rect{ 0, height - line_width, width, line_width },
+		SDL_Rect{ 0, 0, line_width, height },
+		SDL_Rect{ width - line_width, 0, line_width, height }
+	};
+	SDL_FillRects(surface, edges, 4, grey);
 
+	// draw stars
 	for (const auto& star : star_data_) {
 		// check size
 		if (star.star_size == StarSize::NONE) {
 			break;
 		}
 
-		SDL_SetRenderDrawColor(Environment::renderer, 0, 0, 0, SDL_ALPHA_OPAQUE);
+		const Vector2<float> center(star.screen_coords.x * width, star.screen_coords.y * height);
+		const float hole_radius = std::max(getHoleRadius(star.star_size) * px_per_mm, MIN_HOLE_RADIUS_PX);
 
 		// draw appropriate marker
 		switch (star.star_size) {
 			case StarSize::SMALL:
-			
+				fillCircle(surface, center, hole_radius, black);
 				break;
 			case StarSize::MEDIUM:
-
+				fillCircle(surface, center, hole_radius, black);
+				drawRing(surface, center, hole_radius * MARKER_RING_SCALE, static_cast<float>(line_width), black);
 				break;
 			case StarSize::LARGE:
-
+				fillCircle(surface, center, hole_radius, black);
+				drawRing(surface, center, hole_radius * MARKER_RING_SCALE, static_cast<float>(line_width), black);
+				drawCross(surface, center, hole_radius * MARKER_CROSS_SCALE, line_width, black);
+				break;
+			default:
 				break;
 		}
 	}
 
 	// draw segment ID
-
+	const int padding = static_cast<int>(px_per_mm * 10.f);
+	if (label) {
+		SDL_Rect dest = SDL_Rect{ padding, padding, label->w, label->h };
+		SDL_BlitSurface(label, NULL, surface, &dest);
+	}
 
 	// draw north marker
+	const float marker_height = NORTH_MARKER_HEIGHT_MM * px_per_mm;
+	drawNorthMarker(surface, Vector2<float>(width / 2.f, padding + marker_height / 2.f), marker_height, north, black);
 
-
-	// restore renderer target
-	SDL_SetRenderTarget(Environment::renderer, target);
-
-	return target;
-}
\ No newline at end of file
+	return surface;
+}
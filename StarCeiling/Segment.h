@@ -1,5 +1,6 @@
 #pragma once
 
+#include <stdint.h>
 #include <vector>
 #include "types.h"
 
@@ -12,30 +13,52 @@
 
 class Segment
 {
-private:
+public:
 	struct StarData {
 		int id=-1;
-		Vector2<float> screen_coords { 0.f, 0.f };
+		Vector2<float> screen_coords { 0.f, 0.f }; // position within the segment, 0..1 of its size from its top left corner
 		StarSize star_size = StarSize::NONE;
 	};
 
+private:
 	std::vector<StarData> star_data_{};
 	int id_{};
 	Vector2<int> coords_ { 0, 0 };
+	Vector2<float> origin_mm_ { 0.f, 0.f };	// top left corner on the ceiling
+	Vector2<float> size_mm_ { 0.f, 0.f };
+	uint64_t hash_ = 0;						// content of star_data_, see GetHash()
 public:
-	Segment(int id, Vector2<int> coordinates);
+	Segment(int id, Vector2<int> coordinates, Vector2<float> origin_mm, Vector2<float> size_mm);
 
 	// ID
-	int GetID() { return id_; }
+	int GetID() const { return id_; }
 
 	// Coordinates
-	Vector2<int> GetCoordinates() { return coords_; }
+	Vector2<int> GetCoordinates() const { return coords_; }
+	Vector2<float> GetOriginMM() const { return origin_mm_; }
+	Vector2<float> GetSizeMM() const { return size_mm_; }
 
 	// Stars
 	void AddStar(int id, Vector2<float> screen_coordinates, StarSize size);
 	void ClearStars();
+	void ReserveStars(size_t count) { star_data_.reserve(count); }
+	const std::vector<StarData>& GetStars() const { return star_data_; }
 
-	// Texture
-	SDL_Texture* CreateTexture();
-};
+	// Replaces the stars unless they have the same content, returns true if the segment changed
+	bool SetStars(const std::vector<StarData>& stars);
+
+	/*
+		Hash of the hole list: star IDs, positions quantized to HASH_POSITION_STEPS per segment width and
+		sizes, in order. Anything drawn or exported from the segment only needs redoing when it changes.
+	*/
+	uint64_t GetHash() const { return hash_; }
+	static uint64_t HashStars(const std::vector<StarData>& stars);
 
+	/*
+		Draws the drilling template on the CPU at px_per_mm: a marker per star size, the segment ID label
+		(optional, rendered beforehand as fonts aren't thread safe) and a marker pointing north, given in
+		radians clockwise from the panel's top edge. Safe to call from worker threads. The caller frees the
+		returned RGBA32 surface.
+	*/
+	SDL_Surface* CreateTemplate(float px_per_mm, float north, SDL_Surface* label) const;
+};
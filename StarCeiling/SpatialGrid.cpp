@@ -0,0 +1,28 @@
+#include "SpatialGrid.h"
+
+#include <algorithm>
+
+void SpatialGrid::Reset(float cell_size, size_t expected_items) {
+	cell_size_ = std::max(cell_size, 1e-6f);
+	inverse_cell_size_ = 1.f / cell_size_;
+
+	// about two buckets per item keeps the chains short
+	size_t buckets = 16;
+	while (buckets < expected_items * 2) buckets <<= 1;
+	mask_ = buckets - 1;
+
+	heads_.assign(buckets, -1);
+	items_.clear();
+	items_.reserve(expected_items);
+}
+
+void SpatialGrid::Insert(int id, Vector2<float> position) {
+	if (heads_.empty()) Reset(cell_size_, 8);
+
+	const int cell_x = GetCell(position.x);
+	const int cell_y = GetCell(position.y);
+	const size_t bucket = GetBucket(cell_x, cell_y);
+
+	items_.push_back(Item{ id, cell_x, cell_y, position, heads_[bucket] });
+	heads_[bucket] = static_cast<int>(items_.size() - 1);
+}
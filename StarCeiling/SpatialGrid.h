@@ -0,0 +1,71 @@
+#pragma once
+
+#include <math.h>
+#include <stdint.h>
+#include <vector>
+#include "types.h"
+
+/*
+	Uniform grid hash over points: cells of a fixed size are hashed into a table of chained buckets, so
+	inserting a point and finding the points near another are O(1) for evenly spread points, without
+	allocating cells for empty space. Reset() keeps the memory for the next use.
+*/
+class SpatialGrid
+{
+private:
+	struct Item {
+		int id;
+		int cell_x;
+		int cell_y;
+		Vector2<float> position;
+		int next;
+	};
+
+	float cell_size_ = 1.f;
+	float inverse_cell_size_ = 1.f;
+	size_t mask_ = 0;
+	std::vector<int> heads_{};
+	std::vector<Item> items_{};
+
+	int GetCell(float coordinate) const { return static_cast<int>(floorf(coordinate * inverse_cell_size_)); }
+
+	size_t GetBucket(int cell_x, int cell_y) const {
+		const uint32_t hash = static_cast<uint32_t>(cell_x) * 73856093u ^ static_cast<uint32_t>(cell_y) * 19349663u;
+		return hash & mask_;
+	}
+
+public:
+	// Empties the grid; expected_items sizes the hash table
+	void Reset(float cell_size, size_t expected_items);
+
+	void Insert(int id, Vector2<float> position);
+
+	size_t Size() const { return items_.size(); }
+	float GetCellSize() const { return cell_size_; }
+
+	// Calls fn(id, position) for every point within radius of position
+	template <typename F>
+	void ForEachNear(Vector2<float> position, float radius, F&& fn) const {
+		if (items_.empty()) return;
+
+		const float radius_squared = radius * radius;
+		const int x0 = GetCell(position.x - radius);
+		const int x1 = GetCell(position.x + radius);
+		const int y0 = GetCell(position.y - radius);
+		const int y1 = GetCell(position.y + radius);
+		for (int cell_y = y0; cell_y <= y1; cell_y++) {
+			for (int cell_x = x0; cell_x <= x1; cell_x++) {
+				for (int i = heads_[GetBucket(cell_x, cell_y)]; i >= 0; i = items_[i].next) {
+					const Item& item = items_[i];
+					if (item.cell_x != cell_x || item.cell_y != cell_y) continue;
+
+					const float dx = item.position.x - position.x;
+					const float dy = item.position.y - position.y;
+					if (dx * dx + dy * dy <= radius_squared) {
+						fn(item.id, item.position);
+					}
+				}
+			}
+		}
+	}
+};
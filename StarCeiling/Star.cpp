@@ -197,6 +197,12 @@ void Star::UpdateTransforms() {
 }
 
 void Star::SetBrightness() {
-	float brightness_n = (1.f - magnitude_ / (MIN_MAGNITUDE - MAX_MAGNITUDE));
-	brightness_ = std::clamp(static_cast<uint8_t>(MIN_BRIGHTNESS + std::max(MAX_BRIGHTNESS - MIN_BRIGHTNESS, 0) * brightness_n), static_cast<uint8_t>(0), UINT8_MAX);
+	brightness_ = MagnitudeToBrightness(magnitude_);
+}
+
+uint8_t Star::MagnitudeToBrightness(const float magnitude) {
+	float brightness_n = (1.f - magnitude / (MIN_MAGNITUDE - MAX_MAGNITUDE));
+	// merged clusters can be brighter than MAX_MAGNITUDE, so clamp before narrowing
+	const float brightness = MIN_BRIGHTNESS + std::max(MAX_BRIGHTNESS - MIN_BRIGHTNESS, 0) * brightness_n;
+	return static_cast<uint8_t>(std::clamp(brightness, 0.f, static_cast<float>(UINT8_MAX)));
 }
\ No newline at end of file
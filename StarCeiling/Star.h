@@ -167,5 +167,6 @@ public:
 	void UpdateTransforms();
 
 	static RGB TemperatureToColour(unsigned int temp);
+	static uint8_t MagnitudeToBrightness(const float magnitude);
 };
 
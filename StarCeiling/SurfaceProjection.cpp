@@ -0,0 +1,91 @@
+#include "SurfaceProjection.h"
+
+#include <algorithm>
+#include <math.h>
+
+// the surface must enclose the viewer
+static const float MIN_RADIUS = 0.6f;
+
+// directions grazing a barrel's axis would never reach it
+static const float MAX_DISTANCE = 50.f;
+
+static const float NORMALIZED_PER_RADIAN = static_cast<float>(2.0 / M_PI);
+
+void SurfaceProjection::Build(ProjectionMode mode, float radius, int resolution) {
+	mode_ = mode;
+	radius_ = std::max(radius, MIN_RADIUS);
+	if (mode_ == ProjectionMode::FLAT) {
+		resolution_ = 0;
+		x_.clear();
+		y_.clear();
+		return;
+	}
+
+	resolution_ = std::max(resolution, 2);
+	x_.resize(static_cast<size_t>(resolution_) * resolution_);
+	y_.resize(x_.size());
+	const float step = 2.f / (resolution_ - 1);
+	for (int j = 0; j < resolution_; j++) {
+		for (int i = 0; i < resolution_; i++) {
+			const Vector2<float> mapped = Project(mode_, radius_, Vector2<float>(i * step - 1.f, j * step - 1.f));
+			x_[static_cast<size_t>(j) * resolution_ + i] = mapped.x;
+			y_[static_cast<size_t>(j) * resolution_ + i] = mapped.y;
+		}
+	}
+}
+
+Vector2<float> SurfaceProjection::Map(Vector2<float> coords_n) const {
+	if (mode_ == ProjectionMode::FLAT || resolution_ < 2) return coords_n;
+
+	const float scale = (resolution_ - 1) / 2.f;
+	const float gx = std::clamp((coords_n.x + 1.f) * scale, 0.f, resolution_ - 1.001f);
+	const float gy = std::clamp((coords_n.y + 1.f) * scale, 0.f, resolution_ - 1.001f);
+	const int i = static_cast<int>(gx);
+	const int j = static_cast<int>(gy);
+	const float fx = gx - i;
+	const float fy = gy - j;
+
+	const size_t top = static_cast<size_t>(j) * resolution_ + i;
+	const size_t bottom = top + resolution_;
+	auto lerp = [fx, fy, top, bottom](const std::vector<float>& grid) {
+		const float upper = grid[top] + (grid[top + 1] - grid[top]) * fx;
+		const float lower = grid[bottom] + (grid[bottom + 1] - grid[bottom]) * fx;
+		return upper + (lower - upper) * fy;
+	};
+	return Vector2<float>(lerp(x_), lerp(y_));
+}
+
+Vector2<float> SurfaceProjection::Project(ProjectionMode mode, float radius, Vector2<float> coords_n) {
+	if (mode == ProjectionMode::FLAT) return coords_n;
+	radius = std::max(radius, MIN_RADIUS);
+
+	// direction of the star, everything past the horizon is held at the horizon
+	const float theta = std::min(hypotf(coords_n.x, coords_n.y), 1.f) / NORMALIZED_PER_RADIAN;
+	const float phi = atan2f(coords_n.y, coords_n.x);
+	const float dx = sinf(theta) * cosf(phi);
+	const float dy = sinf(theta) * sinf(phi);
+	const float dz = cosf(theta);
+
+	// centre of curvature below the crown, which is at height 1
+	const float centre_z = 1.f - radius;
+	const float c = centre_z * centre_z - radius * radius;
+
+	if (mode == ProjectionMode::BARREL) {
+		// (t dy)^2 + (t dz - centre_z)^2 = radius^2
+		const float a = dy * dy + dz * dz;
+		const float b = -2.f * dz * centre_z;
+		const float t = a > 1e-6f ? std::min((-b + sqrtf(b * b - 4.f * a * c)) / (2.f * a), MAX_DISTANCE) : MAX_DISTANCE;
+
+		// along the axis as is, across it by arc length from the crown
+		const float arc = radius * atan2f(t * dy, t * dz - centre_z);
+		return Vector2<float>(t * dx, arc) * NORMALIZED_PER_RADIAN;
+	}
+
+	// |t d - centre|^2 = radius^2
+	const float b = -2.f * dz * centre_z;
+	const float t = (-b + sqrtf(b * b - 4.f * c)) / 2.f;
+
+	// azimuthal, by arc length from the crown
+	const float arc = radius * atan2f(t * sinf(theta), t * dz - centre_z);
+	return Vector2<float>(arc * cosf(phi), arc * sinf(phi)) * NORMALIZED_PER_RADIAN;
+}
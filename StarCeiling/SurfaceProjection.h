@@ -0,0 +1,36 @@
+#pragma once
+
+#include <vector>
+#include "types.h"
+
+/*
+	Maps the flat normalized screen coordinates of a sky direction onto a curved ceiling, unrolled into
+	flat panel coordinates for fabrication. The viewer stands under the crown, one unit below it; the
+	surface is a cylinder (BARREL, axis along X) or sphere (DOME) of the given radius touching the crown.
+	Positions are unrolled by arc length and scaled so that directions near the zenith land where the flat
+	mapping puts them.
+	The exact ray casting is sampled once into a grid over the unit square, so mapping a star is a
+	bilinear lookup.
+*/
+class SurfaceProjection
+{
+private:
+	ProjectionMode mode_ = ProjectionMode::FLAT;
+	float radius_ = 2.f;
+	int resolution_ = 0;
+	std::vector<float> x_{};
+	std::vector<float> y_{};
+
+public:
+	// samples the mapping, radius is in multiples of the viewer's distance to the crown
+	void Build(ProjectionMode mode, float radius, int resolution);
+
+	ProjectionMode GetMode() const { return mode_; }
+	float GetRadius() const { return radius_; }
+
+	// interpolated from the grid, FLAT returns coords_n unchanged
+	Vector2<float> Map(Vector2<float> coords_n) const;
+
+	// ray cast onto the surface, unrolled
+	static Vector2<float> Project(ProjectionMode mode, float radius, Vector2<float> coords_n);
+};
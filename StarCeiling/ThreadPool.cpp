@@ -0,0 +1,87 @@
+#include "ThreadPool.h"
+#include <atomic>
+#include <algorithm>
+
+ThreadPool::ThreadPool(unsigned int num_threads) {
+	if (num_threads == 0) num_threads = 1;
+
+	for (unsigned int i = 0; i < num_threads; i++) {
+		workers_.emplace_back(&ThreadPool::WorkerLoop, this);
+	}
+}
+
+ThreadPool::~ThreadPool() {
+	{
+		std::lock_guard<std::mutex> lock(mutex_);
+		bStopping_ = true;
+	}
+	condition_.notify_all();
+
+	for (auto& worker : workers_) {
+		if (worker.joinable()) worker.join();
+	}
+}
+
+void ThreadPool::WorkerLoop() {
+	while (true) {
+		std::function<void()> task;
+		{
+			std::unique_lock<std::mutex> lock(mutex_);
+			condition_.wait(lock, [this]() { return bStopping_ || !tasks_.empty(); });
+			if (bStopping_ && tasks_.empty()) return;
+
+			task = std::move(tasks_.front());
+			tasks_.pop();
+		}
+		task();
+	}
+}
+
+void ThreadPool::ParallelFor(int count, const std::function<void(int)>& task) {
+	if (count <= 0) return;
+	if (count == 1) {
+		task(0);
+		return;
+	}
+
+	// shared between the caller and the helpers, which may outlive this call if they start late
+	struct Work {
+		std::function<void(int)> task;
+		std::atomic<int> next{ 0 };
+		std::atomic<int> done{ 0 };
+		int count = 0;
+		std::mutex mutex;
+		std::condition_variable finished;
+	};
+
+	auto work = std::make_shared<Work>();
+	work->task = task;
+	work->count = count;
+
+	auto run = [](const std::shared_ptr<Work>& work) {
+		int i;
+		while ((i = work->next.fetch_add(1)) < work->count) {
+			work->task(i);
+			if (work->done.fetch_add(1) + 1 == work->count) {
+				std::lock_guard<std::mutex> lock(work->mutex);
+				work->finished.notify_all();
+			}
+		}
+	};
+
+	// one helper per worker, the caller works too
+	const int helpers = std::min(count - 1, static_cast<int>(workers_.size()));
+	{
+		std::lock_guard<std::mutex> lock(mutex_);
+		for (int i = 0; i < helpers; i++) {
+			tasks_.emplace([work, run]() { run(work); });
+		}
+	}
+	condition_.notify_all();
+
+	run(work);
+
+	// wait for indices still being processed by helpers
+	std::unique_lock<std::mutex> lock(work->mutex);
+	work->finished.wait(lock, [&work]() { return work->done.load() == work->count; });
+}
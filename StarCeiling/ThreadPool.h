@@ -0,0 +1,54 @@
+#pragma once
+
+#include <vector>
+#include <queue>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <functional>
+#include <future>
+#include <memory>
+
+/*
+	A fixed set of worker threads consuming a shared task queue.
+*/
+class ThreadPool
+{
+private:
+	std::vector<std::thread> workers_{};
+	std::queue<std::function<void()>> tasks_{};
+	std::mutex mutex_{};
+	std::condition_variable condition_{};
+	bool bStopping_ = false;
+
+	void WorkerLoop();
+
+public:
+	explicit ThreadPool(unsigned int num_threads = std::thread::hardware_concurrency());
+	~ThreadPool();
+
+	ThreadPool(const ThreadPool&) = delete;
+	ThreadPool& operator=(const ThreadPool&) = delete;
+
+	unsigned int GetThreadCount() const { return static_cast<unsigned int>(workers_.size()); }
+
+	// Queues a task and returns a future for its result
+	template <typename F>
+	auto Submit(F&& task) -> std::future<decltype(task())> {
+		using result_t = decltype(task());
+		auto packaged = std::make_shared<std::packaged_task<result_t()>>(std::forward<F>(task));
+		std::future<result_t> result = packaged->get_future();
+		{
+			std::lock_guard<std::mutex> lock(mutex_);
+			tasks_.emplace([packaged]() { (*packaged)(); });
+		}
+		condition_.notify_one();
+		return result;
+	}
+
+	/*
+		Runs task(i) for every i in [0, count) and returns when all have finished. The calling thread takes
+		part in the work, so this is safe to call from inside a pool task.
+	*/
+	void ParallelFor(int count, const std::function<void(int)>& task);
+};
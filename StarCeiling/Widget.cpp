@@ -0,0 +1,71 @@
+#include "Widget.h"
+#include "globals.h"
+#include "graphics.h"
+#include <iostream>
+
+Widget::Widget(Vector2<int> position, Vector2<int> size) : position_{ position }, size_{ size } {}
+
+Widget::~Widget() {
+	DestroyTexture();
+}
+
+void Widget::SetSize(Vector2<int> size) {
+	if (size.x == size_.x && size.y == size_.y) return;
+
+	size_ = size;
+	DestroyTexture(); // recreated at the new size on the next update
+}
+
+bool Widget::NeedsUpdate(size_t state) {
+	bool needs_update = !bValid_ || !texture_ || state != state_;
+	state_ = state;
+	return needs_update;
+}
+
+bool Widget::BeginUpdate() {
+	if (size_.x <= 0 || size_.y <= 0) return false;
+
+	if (!texture_) {
+		texture_ = SDL_CreateTexture(Environment::renderer, SDL_PIXELFORMAT_RGBA8888, SDL_TEXTUREACCESS_TARGET, size_.x, size_.y);
+		if (!texture_) {
+			std::cout << "Error creating widget texture: " << SDL_GetError() << "\n";
+			return false;
+		}
+
+		// blended draws into the cleared texture leave premultiplied colour, so composite it as such.
+		// Renderers without custom blend mode support fall back to regular alpha blending.
+		static const SDL_BlendMode premultiplied = SDL_ComposeCustomBlendMode(
+			SDL_BLENDFACTOR_ONE, SDL_BLENDFACTOR_ONE_MINUS_SRC_ALPHA, SDL_BLENDOPERATION_ADD,
+			SDL_BLENDFACTOR_ONE, SDL_BLENDFACTOR_ONE_MINUS_SRC_ALPHA, SDL_BLENDOPERATION_ADD);
+		if (SDL_SetTextureBlendMode(texture_, premultiplied) != 0) {
+			SDL_SetTextureBlendMode(texture_, SDL_BLENDMODE_BLEND);
+		}
+	}
+
+	if (!setRenderTarget(texture_)) return false;
+
+	// clear to transparent
+	setDrawColor(RGBA{ 0, 0, 0, SDL_ALPHA_TRANSPARENT });
+	SDL_RenderClear(Environment::renderer);
+	return true;
+}
+
+void Widget::EndUpdate() {
+	bValid_ = true;
+}
+
+void Widget::Render() const {
+	if (!texture_ || !bValid_) return;
+
+	SDL_Rect dest = SDL_Rect{ position_.x, position_.y, size_.x, size_.y };
+	SDL_RenderCopy(Environment::renderer, texture_, NULL, &dest);
+}
+
+void Widget::DestroyTexture() {
+	if (texture_) {
+		if (getRenderTarget() == texture_) setRenderTarget(NULL);
+		SDL_DestroyTexture(texture_);
+		texture_ = nullptr;
+	}
+	bValid_ = false;
+}
@@ -0,0 +1,52 @@
+#pragma once
+
+#include <stddef.h>
+#include "types.h"
+
+#pragma warning(push, 0)
+#include "SDL.h"
+#pragma warning(pop)
+#undef main
+
+/*
+	A retained UI element. The widget owns a transparent texture that is only re-rendered when the
+	state it displays changes, so each frame just copies the cached texture to the window.
+*/
+class Widget
+{
+private:
+	SDL_Texture* texture_ = nullptr;
+	Vector2<int> position_{ 0, 0 };
+	Vector2<int> size_{ 0, 0 };
+	size_t state_ = 0;
+	bool bValid_ = false;
+
+public:
+	Widget(Vector2<int> position, Vector2<int> size);
+	~Widget();
+
+	Widget(const Widget&) = delete;
+	Widget& operator=(const Widget&) = delete;
+
+	// Position and size in window coordinates
+	Vector2<int> GetPosition() const { return position_; }
+	Vector2<int> GetSize() const { return size_; }
+	void SetPosition(Vector2<int> position) { position_ = position; }
+	void SetSize(Vector2<int> size);
+
+	// Returns true if the given state differs from the one last rendered. The new state is stored.
+	bool NeedsUpdate(size_t state);
+
+	// Forces the next NeedsUpdate() to return true
+	void Invalidate() { bValid_ = false; }
+
+	// Redirects rendering into the widget's texture, which is cleared to transparent. The texture stays bound
+	// after EndUpdate(); the next pass binds its own target.
+	bool BeginUpdate();
+	void EndUpdate();
+
+	// Copies the cached texture to the window
+	void Render() const;
+
+	void DestroyTexture();
+};
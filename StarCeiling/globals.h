@@ -12,10 +12,20 @@
 #include <unordered_map>
 #include <map>
 #include <memory>
+#include <array>
+#include <atomic>
 
 #include "Star.h"
 #include "types.h"
 #include "Segment.h"
+#include "CeilingGeometry.h"
+#include "CeilingMask.h"
+#include "Widget.h"
+#include "Rasterizer.h"
+#include "ThreadPool.h"
+#include "ProjectionCache.h"
+#include "SurfaceProjection.h"
+#include "RenderBackend.h"
 
 namespace Environment {
 	inline SDL_Renderer* renderer = NULL;
@@ -25,6 +35,7 @@ namespace Environment {
 	inline TTF_Font* font_large = NULL;
 	inline TTF_Font* font_title = NULL;
 	inline bool bFontLoaded = false;
+	inline std::unique_ptr<RenderBackend> backend = nullptr;	// where the render functions in graphics.h draw
 	static const std::string fontname = "arial";
 	static bool bUseBlendedFonts = true;
 }
@@ -34,6 +45,15 @@ inline bool bIsActive = false;
 inline bool bStarsChanged = false;
 inline bool bFullscreen = false;
 inline bool bLoadingStars = true;
+inline bool bHeadless = false;								// no window: render the ceiling to headless_output and quit
+inline std::string headless_output = "ceiling.bmp";
+
+// frame pacing
+inline PresentMode present_mode = PresentMode::VSYNC;
+inline int frame_cap = 0;							// max frames per second while animating, 0: display refresh rate
+inline int display_refresh_rate = 60;
+static const Uint32 IDLE_TIMEOUT_MS = 500;			// longest time to block waiting for events while idle
+inline bool bRedraw = true;							// the window needs to be rendered again
 
 inline int WINDOW_WIDTH = 1920;
 inline int WINDOW_HEIGHT = 1080;
@@ -63,9 +83,33 @@ inline int num_stars_large = 0;
 
 inline std::vector <std::pair<int, float>> stars_by_magnitude = {};
 
+static const float star_radius_small = 0.5f;
 static const float star_radius_medium = 0.75f;
 static const float star_radius_large = 1.25f;
 
+// drilled hole diameters in mm
+static const float star_hole_diameter_small = 0.75f;
+static const float star_hole_diameter_medium = 1.f;
+static const float star_hole_diameter_large = 1.5f;
+
+// minimum centre to centre distance in mm between holes of a size, pairs of different sizes use the mean
+static const float min_hole_spacing_small = 3.f;
+static const float min_hole_spacing_medium = 4.f;
+static const float min_hole_spacing_large = 6.f;
+inline SelectionMode selection_mode = SelectionMode::GLOBAL;
+static const float SEGMENT_QUOTA_FACTOR = 1.5f;			// BALANCED: a segment takes at most this multiple of its even share of a tier
+static const float SMALL_FILL_RADIUS_FACTOR = 0.5f;		// BALANCED: small stars keep sqrt(area / max_stars_small) times this apart
+inline float merge_distance_mm = 2.f;					// stars closer than this on the panel share one fiber, 0: off
+static const int CLUSTER_CANDIDATE_FACTOR = 4;			// stars considered for merging, as a multiple of the total budget
+inline bool bEnforceHoleSpacing = true;					// reject stars too close to a brighter selected star
+inline int num_stars_rejected = 0;						// by the spacing rule in the last selection
+
+// star sprites, indexed by StarSize
+static const int STAR_SPRITE_SIZE = 32;			// sprite resolution in pixels
+static const float STAR_SPRITE_EXTENT = 3.f;	// sprite half-width in star radii, leaves room for the glow
+inline std::array<SDL_Texture*, 4> star_sprites = {};
+inline std::vector<SelectedStar> selected_stars = {};
+
 // UI variables
 
 // -- pan
@@ -82,19 +126,69 @@ static const unsigned short MIN_ZOOM = 1;
 static const unsigned short MAX_ZOOM = 50;
 static const float log_min_zoom = static_cast<float>(log(MIN_ZOOM));
 static const float log_max_zoom = static_cast<float>(log(MAX_ZOOM));
-inline float zoom = 1.f;
+inline float zoom = 1.f;							// zoom currently shown, eases towards zoom_target
+inline float zoom_target = 1.f;
 inline float screen_coefficient = 1.f;
 inline unsigned short zoom_steps = MIN_ZOOM;
 
-// Display area: should form a 6x5 grid
+// -- view animation
+static const float ZOOM_SMOOTHING = 0.08f;			// seconds for the zoom to close ~63% of the gap to its target
+static const float PAN_FRICTION = 5.f;				// inertial pan speed decays by e^-friction per second
+static const float PAN_STOP_SPEED = 20.f;			// pixels per second below which inertial panning stops
+static const float MAX_FRAME_DELTA = 1.f / 30.f;	// longest time step of an animation frame
+inline float frame_delta = 0.f;						// seconds since the last frame
+inline Vector2<float> pan_position = { 0.f, 0.f };	// sub-pixel window_offset
+inline Vector2<float> pan_velocity = { 0.f, 0.f };	// pixels per second
+
+// -- progressive refinement
+static const double DRAFT_TIME_BUDGET_MS = 8.0;		// time allowed for a draft selection
+static const Uint32 REFINE_DELAY_MS = 150;			// idle time before the full quality selection
+inline Uint32 last_interaction_ticks = 0;
+inline bool bRefinePending = false;					// the star layer is a draft
+
+// -- framing search (F key)
+static const double FRAMING_TIME_BUDGET_MS = 3000.0;	// the search stops after this long
+static const int FRAMING_RESULTS = 5;					// framings printed, the best is shown
+static const float FRAMING_MAX_ZOOM = 8.f;
+static const int FRAMING_CANDIDATE_FACTOR = 2;			// stars scored, as a multiple of the total budget
+
+// Display area: the ceiling, scaled to fit the window
 static const unsigned int margin = 50;
-inline int ceiling_x = 6; // width in half metres
-inline int ceiling_y = 5; // length in half metres
+inline CeilingGeometry ceiling_geometry{};				// set with STARCEILING_CEILING, see CeilingGeometry::Parse
+inline CeilingMask ceiling_mask{};						// the outline of ceiling_geometry at ceiling_size
 inline Vector2<int> ceiling_size = { 0, 0 };
+inline Vector2<int> ceiling_half = { 0, 0 };
 inline Vector2<int> ceiling_offset = { 0, 0, };
-inline float ceiling_aspect = ceiling_x / static_cast<float>(ceiling_y);
-inline int segment_size = 0;
-inline std::unordered_map<int, std::unique_ptr<Segment>> segments = {};
+inline std::vector<Segment> segments = {};				// one per panel, row by row: segment ID - 1 is the panel index
+static const int HASH_POSITION_STEPS = 1 << 16;		// hole positions closer than 1/65536 of a segment hash the same
+
+// print export, at 1:1 scale
+static const float MM_PER_INCH = 25.4f;
+static const int EXPORT_TILE_SIZE = 256;				// tiles are rasterized in parallel, one row of tiles at a time
+static const float EXPORT_GRID_WIDTH_MM = 1.f;
+static const float EXPORT_LABEL_HEIGHT_MM = 25.f;
+inline int export_dpi = 300;
+inline bool bExportLabels = true;						// segment IDs in the corner of each segment
+inline std::string export_filename = "ceiling_print.png";
+
+// CNC drilling, hole lists are written per segment in mm from the panel's bottom left corner
+static const std::string HOLE_DIRECTORY = "holes";
+static const float DRILL_DEPTH_MM = 20.f;				// through the panel
+static const float DRILL_RETRACT_MM = 2.f;				// clearance above the panel between holes
+static const float DRILL_SAFE_Z_MM = 10.f;				// clearance for tool changes and travel to the first hole
+static const float DRILL_FEED_RATE = 300.f;				// mm per minute
+static const int DRILL_PATH_MAX_PASSES = 16;			// 2-opt and Or-opt passes per drill path, bounded so exports are repeatable
+inline int num_light_engines = 4;						// fiber bundles, raised if they can't hold every hole
+inline int max_fibers_per_bundle = 200;
+static const float FIBER_SLACK_MM = 300.f;				// per fiber: drop from the ceiling and termination at the illuminator
+static const int FIBER_BUNDLE_RESTARTS = 8;
+
+// GENERATE: drilling templates, one image per segment
+static const float TEMPLATE_DPI = 100.f;
+static const std::string TEMPLATE_DIRECTORY = "templates";
+inline bool bGenerating = false;
+inline std::atomic<int> generate_done = 0;				// templates and hole lists finished, written by the workers
+inline int generate_total = 0;
 
 // button 
 static const RGB button_border = { 128, 128, 200 };
@@ -104,13 +198,46 @@ static const Vector2<int> button_pos = { 20, 90 };
 static const Vector2<int> button_size = { 110, 30 };
 inline bool bIsCursorOverButton = false;
 
+// cached UI layer
+inline std::unique_ptr<Widget> info_widget = nullptr;
+inline std::unique_ptr<Widget> button_widget = nullptr;
+inline std::unique_ptr<Widget> grid_widget = nullptr;
+static const Vector2<int> info_pos = { 20, 20 };
+static const Vector2<int> info_size = { 220, 60 };
+static const RGB grid_colour = { 100, 100, 160 };
+static const RGBA border_colour = { 128, 128, 200, 128 };
+
 
 static const float ZERO_TOLERANCE = 0.0000001f;
 static const float _2PI = static_cast<float>(M_PI) * 2.f;
 
 inline std::map<int, std::unique_ptr<Star>> universe = {}; // all stars
-inline std::vector<std::vector<std::pair<int, int>>> constellations = {};
+inline ProjectionCache projection_cache{};						// screen coordinates of all stars, by magnitude
+inline ProjectionMode projection_mode = ProjectionMode::FLAT;	// set with STARCEILING_PROJECTION=flat|barrel|dome[:radius]
+inline float vault_radius = 2.f;								// BARREL and DOME curvature, in multiples of the eye to crown height
+inline SurfaceProjection surface_projection{};
+static const int SURFACE_GRID_RESOLUTION = 129;					// samples per side of the curved surface lookup grid
+inline float sky_rotation = 0.f;								// radians clockwise, turns the sky on top of the ceiling's north
+inline Vector2<float> sky_rotation_cs = { 1.f, 0.f };			// cos, sin of sky_rotation
+inline std::unordered_map<int, Star*> stars_by_hip = {};		// Hipparcos number to star, filled by readCSV
+static const char* CONSTELLATION_FILENAME = "constellationship.fab";	// stick figures by HIP, in Stellarium's format
+static const char* CONSTELLATION_JSON_FILENAME = "constellations.json";	// the same, from a Stellarium sky culture's index.json
+inline std::vector<Constellation> constellations = {};
+inline std::vector<std::pair<Star*, Star*>> constellation_edges = {};	// every figure's edges, resolved once at load
+static const float CONSTELLATION_SAMPLE_ANGLE = 0.035f;		// radians between the points along a constellation line
 
 inline SDL_Texture* star_texture = NULL;
+
+// draw the star layer on the CPU, enabled automatically when the renderer is a software renderer
+inline bool bUseSoftwareRasterizer = false;
+inline std::unique_ptr<Rasterizer> software_rasterizer = nullptr;
+inline std::unique_ptr<ThreadPool> thread_pool = nullptr;
 inline SDL_Texture* ui_texture = NULL;
 inline SDL_Rect star_rect = SDL_Rect{ 0,0,0,0 };
+
+// The star layer is drawn larger than the ceiling, so small pans only move the source rectangle
+static const float STAR_LAYER_MARGIN = 0.25f;				// margin on each side, as a fraction of the ceiling size
+inline Vector2<int> star_layer_margin = { 0, 0 };
+inline Vector2<int> star_layer_size = { 0, 0 };
+inline Vector2<int> star_layer_offset = { 0, 0 };			// window_offset the layer was drawn at
+inline float star_layer_scale = 1.f;						// screen_coefficient the layer was drawn at
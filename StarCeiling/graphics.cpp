@@ -9,13 +9,79 @@
 #include "utilities.h"
 #include "graphics.h"
 #include "star.h"
+#include "Rasterizer.h"
+#include "ThreadPool.h"
+#include "SpatialGrid.h"
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define CONSTELLATION_SSE2
+#include <emmintrin.h>
+#endif
+
+// Renderer state as last set through the functions below
+namespace RenderState {
+	static bool bValid = false;
+	static SDL_Texture* target = nullptr;
+	static RGBA colour{};
+	static SDL_BlendMode blend_mode = SDL_BLENDMODE_NONE;
+}
+
+// Forgets the cached state, e.g. after the renderer was (re)created
+void resetRenderState() {
+	RenderState::bValid = false;
+	RenderState::target = SDL_GetRenderTarget(Environment::renderer);
+}
+
+bool setRenderTarget(SDL_Texture* target) {
+	if (RenderState::bValid && RenderState::target == target) return true;
+
+	if (SDL_SetRenderTarget(Environment::renderer, target) != 0) {
+		std::cout << "Failed to set render target: " << SDL_GetError() << "\n";
+		RenderState::bValid = false;
+		return false;
+	}
+
+	if (!RenderState::bValid) {
+		// colour and blend mode are unknown until set again
+		RenderState::colour = RGBA{ 0, 0, 0, 0 };
+		SDL_GetRenderDrawColor(Environment::renderer, &RenderState::colour.R, &RenderState::colour.G, &RenderState::colour.B, &RenderState::colour.A);
+		SDL_GetRenderDrawBlendMode(Environment::renderer, &RenderState::blend_mode);
+		RenderState::bValid = true;
+	}
+
+	RenderState::target = target;
+	return true;
+}
+
+SDL_Texture* getRenderTarget() {
+	return RenderState::bValid ? RenderState::target : SDL_GetRenderTarget(Environment::renderer);
+}
+
+void setDrawColor(const RGBA& colour) {
+	if (RenderState::bValid && RenderState::colour.R == colour.R && RenderState::colour.G == colour.G
+		&& RenderState::colour.B == colour.B && RenderState::colour.A == colour.A) {
+		return;
+	}
+
+	SDL_SetRenderDrawColor(Environment::renderer, colour.R, colour.G, colour.B, colour.A);
+	RenderState::colour = colour;
+}
+
+void setDrawColor(const RGB& colour) {
+	setDrawColor(RGBA{ colour.R, colour.G, colour.B, SDL_ALPHA_OPAQUE });
+}
+
+void setDrawBlendMode(SDL_BlendMode mode) {
+	if (RenderState::bValid && RenderState::blend_mode == mode) return;
+
+	SDL_SetRenderDrawBlendMode(Environment::renderer, mode);
+	RenderState::blend_mode = mode;
+}
 
 Vector2<int> renderText(const std::string& text, eFontSize size, uint16_t x, uint16_t y, bool center) {
 	Vector2<int> return_size = { 0, 0 };
 	if (!Environment::bFontLoaded) return return_size; // in case fonts didn't load
 
-	SDL_SetRenderTarget(Environment::renderer, NULL); // NULL: render to the window
-	SDL_Texture* font_texture = nullptr;
 	SDL_Color foreground = { 128, 128, 200 };
 
 	// select appropriate font for size
@@ -49,20 +115,12 @@ Vector2<int> renderText(const std::string& text, eFontSize size, uint16_t x, uin
 			return return_size;
 		}
 
-		font_texture = SDL_CreateTextureFromSurface(Environment::renderer, text_surf);
-		if (!font_texture) {
-			SDL_FreeSurface(text_surf);
-			std::cout << "Failed to texture for TTF font: " << SDL_GetError() << "\n";
-			return return_size;
-		}
-
-		SDL_Rect dest = SDL_Rect{ x, y, text_surf->w, text_surf->h };
+		Vector2<int> dest = { x, y };
 		return_size.x = text_surf->w;
 		return_size.y = text_surf->h;
 		if (center) dest.x -= static_cast<int>(text_surf->w / 2.0f); // centered
-		SDL_RenderCopy(Environment::renderer, font_texture, NULL, &dest);
+		if (Environment::backend) Environment::backend->DrawSurface(text_surf, dest);
 
-		SDL_DestroyTexture(font_texture);
 		SDL_FreeSurface(text_surf);
 	}
 
@@ -74,37 +132,8 @@ bool renderRect(const Vector2<int> start, const Vector2<int> size, const RGB& co
 }
 
 bool renderRect(const Vector2<int> start, const Vector2<int> size, const RGBA& color) {
-	// Draw a rectangle
-	//---
-
-	SDL_Rect rect = SDL_Rect{ start.x, start.y, size.x, size.y };
-
-	// store current colour
-	RGBA current_color{};
-	SDL_GetRenderDrawColor(Environment::renderer, &current_color.R, &current_color.G, &current_color.B, &current_color.A);
-
-	// set given colour
-	SDL_SetRenderDrawColor(Environment::renderer, color.R, color.G, color.B, color.A);
-
-	// draw
-	int ret = SDL_RenderDrawRect(Environment::renderer, &rect);
-
-	// restore original colour
-	SDL_SetRenderDrawColor(Environment::renderer, current_color.R, current_color.G, current_color.B, current_color.A);
-
-	// error handling
-	if (ret != 0)
-	{
-		const char* error = SDL_GetError();
-		if (*error != '\0')
-		{
-			SDL_LogError(SDL_LOG_CATEGORY_APPLICATION, "Could not renderRect. SDL Error: %s at line #%d of file %s/n", error, __LINE__, __FILE__);
-			SDL_ClearError();
-		}
-		return false;
-	}
-
-	return true;
+	if (!Environment::backend) return false;
+	return Environment::backend->DrawRect(start, size, color);
 }
 
 bool renderFillRect(const Vector2<int> start, const Vector2<int> size, const RGB& color) {
@@ -112,101 +141,28 @@ bool renderFillRect(const Vector2<int> start, const Vector2<int> size, const RGB
 }
 
 bool renderFillRect(const Vector2<int> start, const Vector2<int> size, const RGBA& color) {
-	// Draw a rectangle
-	//---
-
-	SDL_Rect rect = SDL_Rect{ start.x, start.y, size.x, size.y };
-
-	// store current colour
-	RGBA current_color{};
-	SDL_GetRenderDrawColor(Environment::renderer, &current_color.R, &current_color.G, &current_color.B, &current_color.A);
-
-	// set given colour
-	SDL_SetRenderDrawColor(Environment::renderer, color.R, color.G, color.B, color.A);
-
-	// draw
-	int ret = SDL_RenderFillRect(Environment::renderer, &rect);
-
-	// restore original colour
-	SDL_SetRenderDrawColor(Environment::renderer, current_color.R, current_color.G, current_color.B, current_color.A);
-
-	// error handling
-	if (ret != 0)
-	{
-		const char* error = SDL_GetError();
-		if (*error != '\0')
-		{
-			SDL_LogError(SDL_LOG_CATEGORY_APPLICATION, "Could not renderRect. SDL Error: %s at line #%d of file %s/n", error, __LINE__, __FILE__);
-			SDL_ClearError();
-		}
-		return false;
-	}
-
-	return true;
+	if (!Environment::backend) return false;
+	return Environment::backend->FillRect(start, size, color);
 }
 
 bool renderLine(const Vector2<int> start, const Vector2<int> end, const RGB& color) {
-	RGB oldc;
-
-	int ww, wh;
-	SDL_GetWindowSize(Environment::window,
-		&ww,
-		&wh);
-
-	// Draw a line
-	//---
-	int ret = SDL_RenderDrawLine(
-		Environment::renderer, // SDL_Renderer* renderer: the renderer in which draw
-		start.x,               // int x1: x of the starting point
-		start.y,          // int y1: y of the starting point
-		end.x,                 // int x2: x of the end point
-		end.y);           // int y2: y of the end point
-
-	// error handling
-	if (ret != 0)
-	{
-		const char* error = SDL_GetError();
-		if (*error != '\0')
-		{
-			SDL_LogError(SDL_LOG_CATEGORY_APPLICATION, "Could not renderDrawLine. SDL Error: %s at line #%d of file %s/n", error, __LINE__, __FILE__);
-			SDL_ClearError();
-		}
-		return false;
-	}
+	return renderLine(start, end, RGBA{ color.R, color.G, color.B, SDL_ALPHA_OPAQUE });
+}
 
-	return true;
+bool renderLine(const Vector2<int> start, const Vector2<int> end, const RGBA& color) {
+	return renderLine(
+		Vector2<float>(static_cast<float>(start.x), static_cast<float>(start.y)),
+		Vector2<float>(static_cast<float>(end.x), static_cast<float>(end.y)),
+		color);
 }
 
 bool renderLine(const Vector2<float> start, const Vector2<float> end, const RGB& color) {
-	RGB oldc;
-
-	int ww, wh;
-	SDL_GetWindowSize(Environment::window,
-		&ww,
-		&wh);
-
-	// Draw a line
-	//---
-	int ret = SDL_RenderDrawLine(
-		Environment::renderer, // SDL_Renderer* renderer: the renderer in which draw
-		static_cast<int>(round(start.x)),               // int x1: x of the starting point
-		static_cast<int>(round(start.y)),          // int y1: y of the starting point
-		static_cast<int>(round(end.x)),                 // int x2: x of the end point
-		static_cast<int>(round(end.y)));           // int y2: y of the end point
-
-	// error handling
-	if (ret != 0)
-	{
-		const char* error = SDL_GetError();
-		if (*error != '\0')
-		{
-			SDL_LogError(SDL_LOG_CATEGORY_APPLICATION, "Could not renderDrawLine. SDL Error: %s at line #%d of file %s/n", error, __LINE__, __FILE__);
-			SDL_ClearError();
-		}
-		return false;
-	}
+	return renderLine(start, end, RGBA{ color.R, color.G, color.B, SDL_ALPHA_OPAQUE });
+}
 
-	return true;
+bool renderLine(const Vector2<float> start, const Vector2<float> end, const RGBA& color) {
+	if (!Environment::backend) return false;
+	return Environment::backend->DrawLine(start, end, color);
 }
 
 void renderCircle(const Vector2<int> center, float radius, const RGB& color, unsigned int sides) {
@@ -235,128 +191,709 @@ void renderCircle(const Vector2<int> center, float radius, const RGB& color, uns
 	}
 }
 
-void drawConstellations() {
-	SDL_SetRenderDrawColor(Environment::renderer, constellation_colour.R, constellation_colour.G, constellation_colour.B, 35);
-
-	for (const auto& constellation : constellations) {
-		for (const auto& star_pair : constellation) {
-			auto& star_a = universe.find(star_pair.first)->second;
-			auto& star_b = universe.find(star_pair.second)->second;
-			if (star_a && star_b) {
-				// Screen Coordinates
-				const Vector2<int> screen_coords_a = getScreenCoords(screen_coefficient, star_a->GetScreenCoords()) + window_offset;
-				const Vector2<int> screen_coords_b = getScreenCoords(screen_coefficient, star_b->GetScreenCoords()) + window_offset;
-
-				// Only draw if both stars are on screen
-				bool star_a_in_bounds = (screencoordsInBounds(screen_coords_a, star_a->GetZ()));
-				bool star_b_in_bounds = (screencoordsInBounds(screen_coords_b, star_b->GetZ()));
-
-				if (star_a_in_bounds != star_b_in_bounds) {
-					// only one star is in bounds. interpolate
-					// this interpolation function is not linear, it is a projection from 3D cartesian coordinates to spherical coordinates
-					// step 1 is to get 3D bounds in XYZ cartesian domain by finding spherical coordinates of all 4 corners of window
-					// one plane at Z=0 and one plane at Z=1, both bounded by an edge function
-
-				}
-				else if (star_a_in_bounds && star_b_in_bounds) {
-					renderLine(screen_coords_a, screen_coords_b, constellation_colour);
-				}
+float getStarRadius(StarSize size) {
+	switch (size) {
+	case StarSize::LARGE:
+		return star_radius_large;
+	case StarSize::MEDIUM:
+		return star_radius_medium;
+	case StarSize::SMALL:
+		return star_radius_small;
+	default:
+		return 0.f;
+	}
+}
+
+/*
+	Pre-renders a white, anti-aliased disc with a soft gaussian glow for each star size. Stars are drawn by
+	tinting a sprite with texture colour and alpha modulation and blending it additively.
+*/
+bool createStarSprites() {
+	for (StarSize size : { StarSize::SMALL, StarSize::MEDIUM, StarSize::LARGE }) {
+		auto& sprite = star_sprites[static_cast<size_t>(size)];
+		if (sprite) continue;
+
+		SDL_Surface* surface = SDL_CreateRGBSurfaceWithFormat(0, STAR_SPRITE_SIZE, STAR_SPRITE_SIZE, 32, SDL_PIXELFORMAT_RGBA32);
+		if (!surface) {
+			std::cout << "Error creating star sprite: " << SDL_GetError() << "\n";
+			return false;
+		}
+
+		// distance from the centre is measured in star radii
+		const float pixels_per_radius = STAR_SPRITE_SIZE / (2.f * STAR_SPRITE_EXTENT);
+		SDL_LockSurface(surface);
+		for (int y = 0; y < STAR_SPRITE_SIZE; y++) {
+			uint8_t* row = static_cast<uint8_t*>(surface->pixels) + y * surface->pitch;
+			for (int x = 0; x < STAR_SPRITE_SIZE; x++) {
+				const float dx = (x + 0.5f - STAR_SPRITE_SIZE / 2.f) / pixels_per_radius;
+				const float dy = (y + 0.5f - STAR_SPRITE_SIZE / 2.f) / pixels_per_radius;
+				const float r = sqrtf(dx * dx + dy * dy);
+
+				// disc edge is anti-aliased over one sprite pixel
+				const float disc = std::clamp((1.f - r) * pixels_per_radius + 0.5f, 0.f, 1.f);
+				const float glow = 0.6f * expf(-0.5f * r * r);
+				const float alpha = std::max(disc, glow);
+
+				row[x * 4 + 0] = UINT8_MAX;
+				row[x * 4 + 1] = UINT8_MAX;
+				row[x * 4 + 2] = UINT8_MAX;
+				row[x * 4 + 3] = static_cast<uint8_t>(alpha * UINT8_MAX + 0.5f);
 			}
 		}
+		SDL_UnlockSurface(surface);
+
+		sprite = SDL_CreateTextureFromSurface(Environment::renderer, surface);
+		SDL_FreeSurface(surface);
+		if (!sprite) {
+			std::cout << "Error creating star sprite texture: " << SDL_GetError() << "\n";
+			return false;
+		}
+
+		SDL_SetTextureBlendMode(sprite, SDL_BLENDMODE_ADD);
+		SDL_SetTextureScaleMode(sprite, SDL_ScaleModeLinear);
 	}
+
+	return true;
 }
 
-void drawStars() {
-	SDL_Texture* target = SDL_GetRenderTarget(Environment::renderer);
+void destroyStarSprites() {
+	for (auto& sprite : star_sprites) {
+		if (sprite) {
+			SDL_DestroyTexture(sprite);
+			sprite = nullptr;
+		}
+	}
+}
 
-	if (!star_texture) {
-		star_texture = SDL_CreateTexture(Environment::renderer, SDL_PIXELFORMAT_RGBA8888, SDL_TEXTUREACCESS_TARGET, ceiling_size.x, ceiling_size.y);
-		if (!star_texture) {
-			std::cout << "Error creating star texture: " << SDL_GetError() << "\n";
-			SDL_SetRenderTarget(Environment::renderer, target);
-			return;
+/*
+	Draws the stars as tinted sprites. Stars are sorted by size, so consecutive copies share a texture and
+	are batched by the renderer.
+*/
+void renderStarSprites(const std::vector<SelectedStar>& stars) {
+	for (const auto& star : stars) {
+		SDL_Texture* sprite = star_sprites[static_cast<size_t>(star.size)];
+		if (!sprite) continue;
+
+		const float half_size = getStarRadius(star.size) * STAR_SPRITE_EXTENT;
+		SDL_FRect dest = SDL_FRect{ star.position.x - half_size, star.position.y - half_size, half_size * 2.f, half_size * 2.f };
+
+		SDL_SetTextureColorMod(sprite, star.colour.R, star.colour.G, star.colour.B);
+		SDL_SetTextureAlphaMod(sprite, star.brightness);
+		SDL_RenderCopyF(Environment::renderer, sprite, NULL, &dest);
+	}
+}
+
+/*
+	Draft drawing: one batched call per star size, points for small stars and small squares for the rest,
+	in a single colour.
+*/
+void renderStarPoints(const std::vector<SelectedStar>& stars) {
+	std::vector<SDL_FPoint> points;
+	std::vector<SDL_FRect> rects;
+	points.reserve(stars.size());
+
+	for (const auto& star : stars) {
+		if (star.size == StarSize::SMALL) {
+			points.push_back(SDL_FPoint{ star.position.x, star.position.y });
+		}
+		else {
+			const float radius = getStarRadius(star.size);
+			rects.push_back(SDL_FRect{ star.position.x - radius, star.position.y - radius, radius * 2.f, radius * 2.f });
 		}
 	}
-	
-	// draw to the texture
-	SDL_SetRenderTarget(Environment::renderer, star_texture);
 
-	// fill surface with black
-	SDL_SetRenderDrawColor(Environment::renderer, 0, 0, 0, SDL_ALPHA_OPAQUE);
-	SDL_RenderFillRect(Environment::renderer, NULL);
+	setDrawColor(RGBA{ 220, 220, 235, SDL_ALPHA_OPAQUE });
+	if (!points.empty()) SDL_RenderDrawPointsF(Environment::renderer, points.data(), static_cast<int>(points.size()));
+	if (!rects.empty()) SDL_RenderFillRectsF(Environment::renderer, rects.data(), static_cast<int>(rects.size()));
+}
 
-	// empty collections
-	resetStarCount();
-	clearSegments();
+// Cohen-Sutherland outcodes against the star layer
+static const int OUTSIDE_LEFT = 1 << 0;
+static const int OUTSIDE_RIGHT = 1 << 1;
+static const int OUTSIDE_TOP = 1 << 2;
+static const int OUTSIDE_BOTTOM = 1 << 3;
+
+// points along the visible part of every constellation line, as flat arrays kept between frames
+namespace ArcSamples {
+	static std::vector<float> x{};			// directions, then ceiling pixel coordinates
+	static std::vector<float> y{};
+	static std::vector<float> z{};
+	static std::vector<int> outcodes{};
+	static std::vector<int> ends{};			// one past each line's last sample
+}
 
-	// draw stars
-	screen_coefficient = static_cast<float>(std::min(WINDOW_WIDTH, WINDOW_HEIGHT) * window_scale * zoom);
+static Vector3<float> normalized(const Vector3<float>& v) {
+	const float length = sqrtf(v.x * v.x + v.y * v.y + v.z * v.z);
+	return length > ZERO_TOLERANCE ? v * (1.f / length) : Vector3<float>(0.f, 0.f, 0.f);
+}
 
-	StarSize group_size = StarSize::LARGE;
-	for (const auto& star_id : stars_by_magnitude) {
+/*
+	Appends points along the great circle arc from a to b, at most CONSTELLATION_SAMPLE_ANGLE apart. The
+	normalized chord point (1 - t) a + t b follows the arc, and is on the horizon where its z is 0, so the
+	arc is cut there exactly.
+*/
+static void sampleArc(const Vector3<float>& a, const Vector3<float>& b) {
+	if (a.z <= 0.f && b.z <= 0.f) return;
+
+	float t_start = 0.f;
+	float t_end = 1.f;
+	if (a.z <= 0.f) t_start = a.z / (a.z - b.z);
+	else if (b.z <= 0.f) t_end = a.z / (a.z - b.z);
+
+	const Vector3<float> start = normalized(a * (1.f - t_start) + b * t_start);
+	const Vector3<float> end = normalized(a * (1.f - t_end) + b * t_end);
+	const float cos_angle = std::clamp(start.x * end.x + start.y * end.y + start.z * end.z, -1.f, 1.f);
+	const int steps = std::max(1, static_cast<int>(ceilf(acosf(cos_angle) / CONSTELLATION_SAMPLE_ANGLE)));
+
+	for (int i = 0; i <= steps; i++) {
+		const float s = i / static_cast<float>(steps);
+		const Vector3<float> point = normalized(start * (1.f - s) + end * s);
+		ArcSamples::x.push_back(point.x);
+		ArcSamples::y.push_back(point.y);
+		ArcSamples::z.push_back(point.z);
+	}
+}
 
-		// check if all stars have been drawn
-		if (group_size == StarSize::NONE) {
-			break;
-		}
+// outcodes of the samples against [min, max]
+static void getOutcodes(const Vector2<float>& min, const Vector2<float>& max) {
+	const size_t count = ArcSamples::x.size();
+	ArcSamples::outcodes.resize(count);
+	size_t i = 0;
+
+#ifdef CONSTELLATION_SSE2
+	const __m128 min_x = _mm_set1_ps(min.x);
+	const __m128 min_y = _mm_set1_ps(min.y);
+	const __m128 max_x = _mm_set1_ps(max.x);
+	const __m128 max_y = _mm_set1_ps(max.y);
+	const __m128i left = _mm_set1_epi32(OUTSIDE_LEFT);
+	const __m128i right = _mm_set1_epi32(OUTSIDE_RIGHT);
+	const __m128i top = _mm_set1_epi32(OUTSIDE_TOP);
+	const __m128i bottom = _mm_set1_epi32(OUTSIDE_BOTTOM);
+
+	for (; i + 4 <= count; i += 4) {
+		const __m128 x = _mm_loadu_ps(&ArcSamples::x[i]);
+		const __m128 y = _mm_loadu_ps(&ArcSamples::y[i]);
+		__m128i codes = _mm_and_si128(_mm_castps_si128(_mm_cmplt_ps(x, min_x)), left);
+		codes = _mm_or_si128(codes, _mm_and_si128(_mm_castps_si128(_mm_cmpgt_ps(x, max_x)), right));
+		codes = _mm_or_si128(codes, _mm_and_si128(_mm_castps_si128(_mm_cmplt_ps(y, min_y)), top));
+		codes = _mm_or_si128(codes, _mm_and_si128(_mm_castps_si128(_mm_cmpgt_ps(y, max_y)), bottom));
+		_mm_storeu_si128(reinterpret_cast<__m128i*>(&ArcSamples::outcodes[i]), codes);
+	}
+#endif
 
-		// lookup star by ID
-		auto star_result = universe.find(star_id.first);
+	for (; i < count; i++) {
+		const float x = ArcSamples::x[i];
+		const float y = ArcSamples::y[i];
+		ArcSamples::outcodes[i] = (x < min.x ? OUTSIDE_LEFT : 0) | (x > max.x ? OUTSIDE_RIGHT : 0)
+			| (y < min.y ? OUTSIDE_TOP : 0) | (y > max.y ? OUTSIDE_BOTTOM : 0);
+	}
+}
 
-		// check that the star exists
-		if (star_result == universe.end()) continue;
-		const auto& star = star_result->second;
+/*
+	Appends the constellation lines in the star layer under the last selection, in ceiling pixel coordinates.
+	Each line follows its great circle: it is cut at the horizon, sampled, projected like the stars and
+	clipped to the star layer, so lines leaving the layer end at its edge. Segments wholly inside or wholly
+	beyond one edge are sorted out by their outcodes, only the rest are clipped.
+*/
+void getConstellationLines(Polylines& lines) {
+	ArcSamples::x.clear();
+	ArcSamples::y.clear();
+	ArcSamples::z.clear();
+	ArcSamples::ends.clear();
+	for (const auto& edge : constellation_edges) {
+		sampleArc(edge.first->GetLocation(), edge.second->GetLocation());
+		ArcSamples::ends.push_back(static_cast<int>(ArcSamples::x.size()));
+	}
 
-		// Screen Coordinates
-		const Vector2 screen_coords = getScreenCoords(screen_coefficient, star->GetScreenCoords()) + window_offset;
+	// directions to ceiling pixels, as Star::UpdateTransforms and getScreenCoords do for the stars
+	const Vector2<float> offset(static_cast<float>(ceiling_half.x + star_layer_offset.x), static_cast<float>(ceiling_half.y + star_layer_offset.y));
+	for (size_t i = 0; i < ArcSamples::x.size(); i++) {
+		const float x = ArcSamples::x[i];
+		const float y = ArcSamples::y[i];
+		const float theta_n = 2.f * acosf(std::clamp(ArcSamples::z[i], 0.f, 1.f)) / static_cast<float>(M_PI);
+		const float r = sqrtf(x * x + y * y);
+		const Vector2<float> coords_n = r > ZERO_TOLERANCE ? Vector2<float>(theta_n * x / r, theta_n * y / r) : Vector2<float>(0.f, 0.f);
+		const Vector2<float> coords = projectToCeiling(coords_n);
+		ArcSamples::x[i] = coords.x * screen_coefficient + offset.x;
+		ArcSamples::y[i] = coords.y * screen_coefficient + offset.y;
+	}
 
-		// Check that the star fits on the screen
-		if (!screencoordsInBounds(screen_coords, star->GetZ())) continue;
+	const Vector2<float> min(static_cast<float>(-star_layer_margin.x), static_cast<float>(-star_layer_margin.y));
+	const Vector2<float> max(static_cast<float>(ceiling_size.x + star_layer_margin.x), static_cast<float>(ceiling_size.y + star_layer_margin.y));
+	getOutcodes(min, max);
+
+	int start = 0;
+	for (int end : ArcSamples::ends) {
+		bool bOpen = false;
+		for (int i = start + 1; i < end; i++) {
+			const int code_a = ArcSamples::outcodes[i - 1];
+			const int code_b = ArcSamples::outcodes[i];
+			const Vector2<float> a(ArcSamples::x[i - 1], ArcSamples::y[i - 1]);
+			const Vector2<float> b(ArcSamples::x[i], ArcSamples::y[i]);
+
+			if ((code_a | code_b) == 0) {
+				if (!bOpen) lines.points.push_back(a);
+				lines.points.push_back(b);
+				bOpen = true;
+				continue;
+			}
 
-		// Check that the max hasn't been reached
-		switch (group_size) {
-		case StarSize::LARGE:
-			if (num_stars_large >= max_stars_large) {
-				group_size = StarSize::MEDIUM;
+			Vector2<float> clipped_a = a;
+			Vector2<float> clipped_b = b;
+			if ((code_a & code_b) != 0 || !clipLine(clipped_a, clipped_b, min, max)) {
+				if (bOpen) lines.EndStrip();
+				bOpen = false;
+				continue;
 			}
-			break;
-		case StarSize::MEDIUM:
-			if (num_stars_medium >= max_stars_medium) {
-				group_size = StarSize::SMALL;
+
+			if (!bOpen) lines.points.push_back(clipped_a);
+			lines.points.push_back(clipped_b);
+			bOpen = true;
+
+			// left the layer
+			if (code_b != 0) {
+				lines.EndStrip();
+				bOpen = false;
 			}
-			break;
+		}
+		if (bOpen) lines.EndStrip();
+		start = end;
+	}
+}
 
-		case StarSize::SMALL:
-			if (num_stars_small >= max_stars_small) {
-				group_size = StarSize::NONE;
-				continue;
+void drawConstellations() {
+	Polylines lines;
+	getConstellationLines(lines);
+
+	// layer coordinates
+	const Vector2<float> margin(static_cast<float>(star_layer_margin.x), static_cast<float>(star_layer_margin.y));
+	for (auto& point : lines.points) {
+		point += margin;
+	}
+
+	if (Environment::backend) {
+		Environment::backend->DrawPolylines(lines, RGBA{ constellation_colour.R, constellation_colour.G, constellation_colour.B, 35 });
+	}
+}
+
+// holes placed by the current selection, indexed by StarSize, each with cells of its minimum spacing
+static std::array<SpatialGrid, 4> hole_grids{};
+
+static float getHoleSpacing(StarSize size) {
+	switch (size) {
+	case StarSize::LARGE:
+		return min_hole_spacing_large;
+	case StarSize::MEDIUM:
+		return min_hole_spacing_medium;
+	default:
+		return min_hole_spacing_small;
+	}
+}
+
+static void resetHoleGrids(float px_per_mm) {
+	hole_grids[static_cast<size_t>(StarSize::SMALL)].Reset(min_hole_spacing_small * px_per_mm, max_stars_small);
+	hole_grids[static_cast<size_t>(StarSize::MEDIUM)].Reset(min_hole_spacing_medium * px_per_mm, max_stars_medium);
+	hole_grids[static_cast<size_t>(StarSize::LARGE)].Reset(min_hole_spacing_large * px_per_mm, max_stars_large);
+}
+
+// true if a hole of the given size at position would be too close to a hole already placed
+static bool isTooCloseToHole(Vector2<float> position, StarSize size, float px_per_mm) {
+	const float spacing = getHoleSpacing(size);
+	bool bTooClose = false;
+	for (StarSize placed : { StarSize::LARGE, StarSize::MEDIUM, StarSize::SMALL }) {
+		const float radius = (spacing + getHoleSpacing(placed)) / 2.f * px_per_mm;
+		hole_grids[static_cast<size_t>(placed)].ForEachNear(position, radius, [&bTooClose](int, Vector2<float>) {
+			bTooClose = true;
+		});
+		if (bTooClose) return true;
+	}
+	return false;
+}
+
+namespace {
+	// a star, or a cluster of stars merged into one fiber, offered to the tier selection
+	struct Candidate {
+		const Star* star;			// brightest member
+		Vector2<float> position;	// layer coordinates
+		float magnitude;
+		uint8_t brightness;
+		bool bOnCeiling;
+	};
+}
+
+static SpatialGrid cluster_grid{};
+
+static bool isOnCeiling(Vector2<float> layer_coords) {
+	const Vector2<float> coords = layer_coords - star_layer_margin;
+	return coords.x > 0.f && coords.x < ceiling_size.x && coords.y > 0.f && coords.y < ceiling_size.y;
+}
+
+// on the ceiling rectangle, but cut out by its outline
+static bool isExcluded(Vector2<float> layer_coords) {
+	const Vector2<float> coords = layer_coords - star_layer_margin;
+	return isOnCeiling(layer_coords) && !ceiling_mask.Contains(static_cast<int>(lrintf(coords.x)), static_cast<int>(lrintf(coords.y)));
+}
+
+/*
+	Merges candidates closer than merge_distance into single fibers. In magnitude order, each candidate
+	joins the nearest brighter cluster seed in reach, or seeds a cluster of its own; only seeds go into the
+	grid hash, so no member is further than merge_distance from its seed and clusters can't chain.
+	A cluster takes the summed flux of its members as its magnitude, the flux weighted mean position, and
+	the colour and ID of its brightest member (the seed). The result stays in magnitude order.
+*/
+static void clusterCandidates(std::vector<Candidate>& candidates, float merge_distance) {
+	const int count = static_cast<int>(candidates.size());
+	if (count < 2 || merge_distance <= 0.f) return;
+
+	cluster_grid.Reset(merge_distance, candidates.size());
+	std::vector<int> seed(count);
+	bool bMerged = false;
+	for (int i = 0; i < count; i++) {
+		seed[i] = i;
+		float nearest = merge_distance;
+		cluster_grid.ForEachNear(candidates[i].position, merge_distance, [&](int j, Vector2<float> position) {
+			const float distance = hypotf(position.x - candidates[i].position.x, position.y - candidates[i].position.y);
+			if (distance <= nearest) {
+				nearest = distance;
+				seed[i] = j;
 			}
-			break;
+		});
+
+		if (seed[i] == i) cluster_grid.Insert(i, candidates[i].position);
+		else bMerged = true;
+	}
+	if (!bMerged) return;
+
+	// sum flux and flux weighted position per cluster
+	std::vector<float> flux(count, 0.f);
+	std::vector<Vector2<float>> weighted(count, Vector2<float>(0.f, 0.f));
+	std::vector<int> members(count, 0);
+	for (int i = 0; i < count; i++) {
+		const int root = seed[i];
+		const float star_flux = powf(10.f, -0.4f * candidates[i].magnitude);
+		flux[root] += star_flux;
+		weighted[root] += candidates[i].position * star_flux;
+		members[root]++;
+	}
+
+	std::vector<Candidate> clusters;
+	clusters.reserve(count);
+	for (int i = 0; i < count; i++) {
+		if (seed[i] != i) continue;
+
+		Candidate cluster = candidates[i];
+		if (members[i] > 1) {
+			cluster.position = weighted[i] / flux[i];
+			cluster.magnitude = -2.5f * log10f(flux[i]);
+			cluster.brightness = Star::MagnitudeToBrightness(cluster.magnitude);
+			cluster.bOnCeiling = isOnCeiling(cluster.position);
+			if (isExcluded(cluster.position)) continue;
 		}
+		clusters.push_back(cluster);
+	}
+
+	// merged clusters are brighter than their brightest member
+	std::stable_sort(clusters.begin(), clusters.end(), [](const Candidate& a, const Candidate& b) { return a.magnitude < b.magnitude; });
+	candidates.swap(clusters);
+}
 
-		updateSegment(star->GetID(), (star->GetScreenCoords() + window_offset) * screen_coefficient, group_size);
+// BALANCED selection state: stars per segment and tier, and the small stars placed so far
+namespace Balance {
+	static std::vector<std::array<int, 4>> segment_counts{};
+	static std::vector<float> shares{};		// fraction of the ceiling's area in each segment
+	static SpatialGrid small_grid{};
+	static float small_radius = 0.f;
+}
 
-		// Color
-		const uint8_t brightness = star->GetBrightness();
-		SDL_SetRenderDrawColor(Environment::renderer, star->GetColour().R, star->GetColour().G, star->GetColour().B, brightness);
+static void resetBalance() {
+	Balance::segment_counts.assign(segments.size(), std::array<int, 4>{});
 
-		// if the star is bright enough, draw a larger dot
-		switch (group_size) {
-		case StarSize::LARGE:
-			renderCircle(screen_coords, star_radius_large, star->GetColour(), 4);
-			num_stars_large++;
+	// trimmed edge panels get a smaller share
+	const Vector2<float> ceiling_mm = ceiling_geometry.GetSizeMM();
+	Balance::shares.clear();
+	for (const auto& segment : segments) {
+		const Vector2<float> size = segment.GetSizeMM();
+		Balance::shares.push_back(size.x * size.y / (ceiling_mm.x * ceiling_mm.y));
+	}
+
+	// Poisson disk style spacing that would spread the small budget evenly over the ceiling
+	Balance::small_radius = SMALL_FILL_RADIUS_FACTOR * sqrtf(static_cast<float>(ceiling_size.x) * ceiling_size.y / std::max(max_stars_small, 1));
+	Balance::small_grid.Reset(Balance::small_radius, max_stars_small);
+}
+
+// true if the segment hasn't reached its quota of the tier
+static bool hasSegmentRoom(StarSize size, int segment) {
+	if (segment >= static_cast<int>(Balance::segment_counts.size())) return true;
+
+	int max_stars = max_stars_small;
+	if (size == StarSize::LARGE) max_stars = max_stars_large;
+	else if (size == StarSize::MEDIUM) max_stars = max_stars_medium;
+
+	const int quota = std::max(static_cast<int>(ceilf(SEGMENT_QUOTA_FACTOR * max_stars * Balance::shares[segment])), 1);
+	return Balance::segment_counts[segment][static_cast<size_t>(size)] < quota;
+}
+
+// the next smaller tier with room left in its budget, NONE after SMALL
+static StarSize getNextTier(StarSize size) {
+	if (size == StarSize::LARGE && num_stars_medium < max_stars_medium) return StarSize::MEDIUM;
+	if ((size == StarSize::LARGE || size == StarSize::MEDIUM) && num_stars_small < max_stars_small) return StarSize::SMALL;
+	return StarSize::NONE;
+}
+
+// true if a small star would crowd one already placed
+static bool isCrowded(const Candidate& candidate) {
+	bool bCrowded = false;
+	Balance::small_grid.ForEachNear(candidate.position, Balance::small_radius, [&bCrowded](int, Vector2<float>) {
+		bCrowded = true;
+	});
+	return bCrowded;
+}
+
+/*
+	Offers a candidate to the tier selection, in magnitude order. Returns false once every tier is full.
+*/
+static bool selectCandidate(const Candidate& candidate, StarSize& group_size, float px_per_mm) {
+	if (!candidate.bOnCeiling) {
+		// margin only
+		selected_stars.push_back(SelectedStar{ candidate.star->GetID(), candidate.position, group_size, candidate.star->GetColour(), candidate.brightness, false });
+		return true;
+	}
+
+	// Check that the max hasn't been reached
+	switch (group_size) {
+	case StarSize::LARGE:
+		if (num_stars_large >= max_stars_large) {
+			group_size = StarSize::MEDIUM;
+		}
+		break;
+	case StarSize::MEDIUM:
+		if (num_stars_medium >= max_stars_medium) {
+			group_size = StarSize::SMALL;
+		}
+		break;
+
+	case StarSize::SMALL:
+		if (num_stars_small >= max_stars_small) {
+			group_size = StarSize::NONE;
+			return false;
+		}
+		break;
+	default:
+		return false;
+	}
+
+	// spread the budgets over the segments: a star in a segment over its quota of the tier is demoted
+	// to the next tier with room, so sparse segments still fill up
+	StarSize size = group_size;
+	const bool bBalanced = selection_mode == SelectionMode::BALANCED;
+	const int segment = bBalanced ? getSegmentIndex(candidate.position - star_layer_margin) : 0;
+	if (bBalanced) {
+		while (size != StarSize::NONE && !hasSegmentRoom(size, segment)) {
+			size = getNextTier(size);
+		}
+		if (size == StarSize::NONE || (size == StarSize::SMALL && isCrowded(candidate))) {
+			return true;
+		}
+	}
+
+	// a fainter star too close to a selected hole can't be drilled
+	if (bEnforceHoleSpacing) {
+		if (isTooCloseToHole(candidate.position, size, px_per_mm)) {
+			num_stars_rejected++;
+			return true;
+		}
+		hole_grids[static_cast<size_t>(size)].Insert(candidate.star->GetID(), candidate.position);
+	}
+
+	if (bBalanced && segment < static_cast<int>(Balance::segment_counts.size())) {
+		Balance::segment_counts[segment][static_cast<size_t>(size)]++;
+		if (size == StarSize::SMALL) {
+			Balance::small_grid.Insert(candidate.star->GetID(), candidate.position);
+		}
+	}
+
+	switch (size) {
+	case StarSize::LARGE:
+		num_stars_large++;
+		break;
+	case StarSize::MEDIUM:
+		num_stars_medium++;
+		break;
+	case StarSize::SMALL:
+		num_stars_small++;
+		break;
+	default:
+		break;
+	}
+
+	selected_stars.push_back(SelectedStar{
+		candidate.star->GetID(),
+		candidate.position,
+		size,
+		candidate.star->GetColour(),
+		candidate.brightness,
+		true
+	});
+	return true;
+}
+
+/*
+	Picks the brightest stars on the ceiling for each size tier, filling selected_stars and the star counts.
+	Stars in the layer's margin are drawn with the tier in effect at their magnitude, but don't count towards
+	the budgets.
+	A DRAFT selection stops when its time budget runs out, so only the brightest stars may be chosen, and
+	leaves the segments as they were. A FULL selection bins the stars on the ceiling into the segments.
+	The brightest stars are first merged into clusters where they are closer than merge_distance_mm, so
+	that a tight group uses one fiber of the budget.
+	In BALANCED mode each segment takes at most SEGMENT_QUOTA_FACTOR times its even share of every tier,
+	further stars there are demoted to the next tier with room, and small stars are kept a minimum distance apart, so bright regions can't use up the budgets.
+	With bEnforceHoleSpacing, a star closer to an already selected (brighter) hole than the minimum spacing
+	of the two sizes is skipped without using up the budget.
+*/
+void selectStars(RenderQuality quality) {
+	const Uint64 deadline = SDL_GetPerformanceCounter() + static_cast<Uint64>(DRAFT_TIME_BUDGET_MS * SDL_GetPerformanceFrequency() / 1000.0);
+
+	// empty collections
+	resetStarCount();
+	selected_stars.clear();
+	num_stars_rejected = 0;
+
+	// draw stars
+	screen_coefficient = getScreenCoefficient();
+	star_layer_offset = window_offset;
+	star_layer_scale = screen_coefficient;
+
+	// project every star in one pass
+	if (!projection_cache.IsValid()) {
+		projection_cache.Rebuild();
+	}
+	projection_cache.Transform(screen_coefficient, window_offset);
+
+	const float px_per_mm = getScreenPixelsPerMM();
+	if (bEnforceHoleSpacing) {
+		resetHoleGrids(px_per_mm);
+	}
+	if (selection_mode == SelectionMode::BALANCED) {
+		resetBalance();
+	}
+
+	auto make_candidate = [](size_t row, uint8_t flags) {
+		const Star* star = projection_cache.GetStar(row);
+		return Candidate{
+			star,
+			projection_cache.GetScreenCoordsF(row) + star_layer_margin,
+			star->GetMagnitude(),
+			star->GetBrightness(),
+			(flags & ProjectionCache::IN_CEILING) != 0
+		};
+	};
+
+	// the brightest stars in the layer are clustered first
+	std::vector<Candidate> candidates;
+	size_t row = 0;
+	const size_t num_rows = projection_cache.Size();
+	if (merge_distance_mm > 0.f) {
+		const size_t max_candidates = static_cast<size_t>(CLUSTER_CANDIDATE_FACTOR * (max_stars_large + max_stars_medium + max_stars_small));
+		candidates.reserve(max_candidates);
+		for (; row < num_rows && candidates.size() < max_candidates; row++) {
+			if (quality == RenderQuality::DRAFT && (row & 1023) == 0 && SDL_GetPerformanceCounter() > deadline) break;
+
+			const uint8_t flags = projection_cache.GetFlags(row);
+			if ((flags & ProjectionCache::IN_LAYER) != 0) {
+				candidates.push_back(make_candidate(row, flags));
+			}
+		}
+		clusterCandidates(candidates, merge_distance_mm * px_per_mm);
+	}
+
+	StarSize group_size = StarSize::LARGE;
+	bool bFull = false;
+	for (size_t i = 0; i < candidates.size() && !bFull; i++) {
+		if (quality == RenderQuality::DRAFT && (i & 255) == 0 && SDL_GetPerformanceCounter() > deadline) {
+			bFull = true;
 			break;
-		case StarSize::MEDIUM:
-			renderCircle(screen_coords, star_radius_medium, star->GetColour(), 4);
-			num_stars_medium++;
+		}
+		bFull = !selectCandidate(candidates[i], group_size, px_per_mm);
+	}
+
+	// then the rest, one star at a time
+	for (; row < num_rows && !bFull; row++) {
+
+		// out of time for a draft
+		if (quality == RenderQuality::DRAFT && (row & 1023) == 0 && SDL_GetPerformanceCounter() > deadline) {
 			break;
-		case StarSize::SMALL:
-			SDL_RenderDrawPoint(Environment::renderer, screen_coords.x, screen_coords.y);
-			num_stars_small++;
 		}
+
+		// Check that the star fits in the layer
+		const uint8_t flags = projection_cache.GetFlags(row);
+		if ((flags & ProjectionCache::IN_LAYER) == 0) continue;
+
+		bFull = !selectCandidate(make_candidate(row, flags), group_size, px_per_mm);
+	}
+
+	if (quality == RenderQuality::FULL) {
+		binStarsIntoSegments(selected_stars);
 	}
+}
+
+bool createStarTexture() {
+	if (star_texture) return true;
+
+	// the software rasterizer uploads its pixels, the renderer draws into the texture
+	if (bUseSoftwareRasterizer) {
+		star_texture = SDL_CreateTexture(Environment::renderer, SDL_PIXELFORMAT_RGBA32, SDL_TEXTUREACCESS_STREAMING, star_layer_size.x, star_layer_size.y);
+	}
+	else {
+		star_texture = SDL_CreateTexture(Environment::renderer, SDL_PIXELFORMAT_RGBA8888, SDL_TEXTUREACCESS_TARGET, star_layer_size.x, star_layer_size.y);
+	}
+
+	if (!star_texture) {
+		std::cout << "Error creating star texture: " << SDL_GetError() << "\n";
+		return false;
+	}
+
+	// smooth while the layer is scaled during zoom animation
+	SDL_SetTextureScaleMode(star_texture, SDL_ScaleModeLinear);
+	return true;
+}
+
+void drawStars(RenderQuality quality) {
+	if (!Environment::backend || !Environment::backend->BeginStarLayer(star_layer_size)) return;
+
+	selectStars(quality);
+	Environment::backend->DrawStars(selected_stars, quality);
 
 	// Draw constellations
-	drawConstellations();
-	SDL_SetRenderTarget(Environment::renderer, target);
-}
\ No newline at end of file
+	if (quality == RenderQuality::FULL) {
+		drawConstellations();
+	}
+
+	Environment::backend->EndStarLayer();
+}
+
+/*
+	Where the cached star layer lands relative to the ceiling at the current zoom and window_offset. The layer
+	was drawn at star_layer_scale and star_layer_offset; while the view moves it is shifted and scaled to
+	match rather than redrawn.
+*/
+SDL_FRect getStarLayerDest() {
+	const float k = getScreenCoefficient() / star_layer_scale;
+
+	// a layer pixel t lands at k * (t - half - layer_offset - margin) + half + window_offset
+	return SDL_FRect{
+		ceiling_half.x + window_offset.x - k * (ceiling_half.x + star_layer_offset.x + star_layer_margin.x),
+		ceiling_half.y + window_offset.y - k * (ceiling_half.y + star_layer_offset.y + star_layer_margin.y),
+		k * star_layer_size.x,
+		k * star_layer_size.y
+	};
+}
+
+// false once the view has moved the ceiling past the edge of the cached layer
+bool starLayerCoversCeiling() {
+	if (!star_texture) return false;
+
+	const SDL_FRect dest = getStarLayerDest();
+	return dest.x <= 0.f && dest.y <= 0.f
+		&& dest.x + dest.w >= ceiling_size.x
+		&& dest.y + dest.h >= ceiling_size.y;
+}
@@ -1,15 +1,40 @@
 #pragma once
 
 #include <string.h>
+#include <vector>
+#include <utility>
 #include "types.h"
 
+#pragma warning(push, 0)
+#include "SDL.h"
+#pragma warning(pop)
+#undef main
+
+void resetRenderState();
+bool setRenderTarget(SDL_Texture* target);
+SDL_Texture* getRenderTarget();
+void setDrawColor(const RGBA& colour);
+void setDrawColor(const RGB& colour);
+void setDrawBlendMode(SDL_BlendMode mode);
 Vector2<int> renderText(const std::string& text, eFontSize size, uint16_t x, uint16_t y, bool center);
 void renderCircle(const Vector2<int> center, float radius, const RGB& color, unsigned int sides);
 bool renderLine(const Vector2<float> start, const Vector2<float> end, const RGB& color);
 bool renderLine(const Vector2<int> start, const Vector2<int> end, const RGB& color);
+bool renderLine(const Vector2<float> start, const Vector2<float> end, const RGBA& color);
+bool renderLine(const Vector2<int> start, const Vector2<int> end, const RGBA& color);
 bool renderRect(const Vector2<int> start, const Vector2<int> end, const RGB& color);
 bool renderRect(const Vector2<int> start, const Vector2<int> end, const RGBA& color);
 bool renderFillRect(const Vector2<int> start, const Vector2<int> end, const RGB& color);
 bool renderFillRect(const Vector2<int> start, const Vector2<int> end, const RGBA& color);
+float getStarRadius(StarSize size);
+bool createStarSprites();
+void destroyStarSprites();
+void renderStarSprites(const std::vector<SelectedStar>& stars);
+void getConstellationLines(Polylines& lines);
 void drawConstellations();
-void drawStars();
\ No newline at end of file
+void renderStarPoints(const std::vector<SelectedStar>& stars);
+void selectStars(RenderQuality quality);
+bool createStarTexture();
+void drawStars(RenderQuality quality);
+SDL_FRect getStarLayerDest();
+bool starLayerCoversCeiling();
\ No newline at end of file
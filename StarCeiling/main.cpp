@@ -8,6 +8,7 @@
 
 #include <iostream>
 #include <stdlib.h>     /* srand, rand */
+#include <charconv>
 #include <chrono>
 #include <fstream>
 #include <sstream>
@@ -21,6 +22,11 @@
 #include "globals.h"
 #include "Star.h"
 #include "types.h"
+#include "SdlBackend.h"
+#include "FramebufferBackend.h"
+#include "Export.h"
+#include "Generate.h"
+#include "Framing.h"
 
 inline void setLatitude(float degrees) {
 	latitude = static_cast<float>(M_PI * (0.5f - degrees / 180));
@@ -31,11 +37,12 @@ inline void setLatitude(float degrees) {
 */
 void calculateCeilingSize() {
 	float screen_aspect = WINDOW_WIDTH / static_cast<float>(WINDOW_HEIGHT); // width / height, calculated here becuase it may be variable in future.
+	const float ceiling_aspect = ceiling_geometry.GetAspect();
 
 	if (ceiling_aspect > screen_aspect) {
 		// ceiling size
 		ceiling_size.x = WINDOW_WIDTH - margin * 2;
-		ceiling_size.y = static_cast<int>(ceiling_size.x * ceiling_y / static_cast<float>(ceiling_x));
+		ceiling_size.y = static_cast<int>(ceiling_size.x / ceiling_aspect);
 		// offset
 		ceiling_offset.x = margin;
 		ceiling_offset.y = static_cast<int>(std::round((WINDOW_HEIGHT - ceiling_size.y) / 2.0));
@@ -43,34 +50,78 @@ void calculateCeilingSize() {
 	else {
 		// ceiling size
 		ceiling_size.y = WINDOW_HEIGHT - margin * 2;
-		ceiling_size.x = static_cast<int>(ceiling_size.y * ceiling_x / static_cast<float>(ceiling_y));
+		ceiling_size.x = static_cast<int>(ceiling_size.y * ceiling_aspect);
 		// offset
 		ceiling_offset.x = static_cast<int>(std::round((WINDOW_WIDTH - ceiling_size.x) / 2.0));
 		ceiling_offset.y = margin;
 	}
 	
-	segment_size = ceiling_size.x / ceiling_x;
+	ceiling_half = ceiling_size / 2;
+
+	star_layer_margin.x = static_cast<int>(ceiling_size.x * STAR_LAYER_MARGIN);
+	star_layer_margin.y = static_cast<int>(ceiling_size.y * STAR_LAYER_MARGIN);
+	star_layer_size = ceiling_size + star_layer_margin * 2;
+
+	ceiling_mask.Build(ceiling_geometry, ceiling_size);
+}
+
+/*
+	Rebuilds everything sized from the ceiling: its rectangle in the window, the segments and the star layer
+	texture. Call when the window is resized or ceiling_geometry changes.
+*/
+void updateCeilingLayout() {
+	calculateCeilingSize();
+	star_rect = SDL_Rect{ ceiling_offset.x, ceiling_offset.y, ceiling_size.x, ceiling_size.y };
+	rebuildSegments();
+
+	if (star_texture) {
+		SDL_DestroyTexture(star_texture);
+		star_texture = NULL;
+	}
+
+	projection_cache.Invalidate();
+	bStarsChanged = true;
+	bRedraw = true;
 }
 
 int main() {
-	int SDL_RENDERER_FLAGS = 0;
+	int SDL_RENDERER_FLAGS = (present_mode == PresentMode::VSYNC) ? SDL_RENDERER_PRESENTVSYNC : 0;
 	int SDL_WINDOW_INDEX = -1;
 
 	// set latitude of Adelaide
 	setLatitude(-34.814712f);
 	updateZoom(); // set initial zoom values 
+	zoom = zoom_target;
 
-	populateConstellations();
+	thread_pool = std::make_unique<ThreadPool>();
 
-	// set up segments:
-	int id = 1;
-	for (int y = 1; y <= ceiling_y; y++) {
-		for (int x = 1; x <= ceiling_x; x++) {
-			segments.insert({ id, std::make_unique<Segment>(id, Vector2<int> {x, y}) });
-			id++;
-		}
+	// room and panel sizes, e.g. STARCEILING_CEILING=3600x2400/600x600@90
+	const char* ceiling_env = getenv("STARCEILING_CEILING");
+	if (ceiling_env && !CeilingGeometry::Parse(ceiling_env, ceiling_geometry)) {
+		std::cout << "Invalid ceiling \"" << ceiling_env << "\", expected <width>x<length>[/<panel width>x<panel length>][@<north degrees>] in mm\n";
+	}
+	// L-shaped rooms and cut outs, see CeilingGeometry::LoadOutline
+	const char* outline_env = getenv("STARCEILING_OUTLINE");
+	if (outline_env) {
+		ceiling_geometry.LoadOutline(outline_env);
+	}
+	// curved ceilings, e.g. STARCEILING_PROJECTION=dome:3
+	const char* projection_env = getenv("STARCEILING_PROJECTION");
+	if (projection_env) {
+		const std::string projection = projection_env;
+		const std::string shape = projection.substr(0, projection.find(':'));
+		float radius = vault_radius;
+		if (shape.size() < projection.size()) radius = strtof(projection.c_str() + shape.size() + 1, nullptr);
+
+		if (shape == "barrel") setProjectionMode(ProjectionMode::BARREL, radius);
+		else if (shape == "dome") setProjectionMode(ProjectionMode::DOME, radius);
+		else if (shape != "flat") std::cout << "Unknown projection \"" << projection << "\", expected flat, barrel or dome\n";
 	}
 
+	const Vector2<int> panels = ceiling_geometry.GetPanelCount();
+	std::cout << "Ceiling: " << ceiling_geometry.GetSizeMM().x << " x " << ceiling_geometry.GetSizeMM().y << " mm, "
+		<< panels.x << " x " << panels.y << " panels\n";
+
 	int SDL_WINDOW_FLAGS = 0;
 	SDL_WINDOW_FLAGS = SDL_WINDOW_RESIZABLE | SDL_WINDOW_MAXIMIZED;
 
@@ -78,8 +129,21 @@ int main() {
 		SDL_WINDOW_FLAGS = SDL_WINDOW_FLAGS | SDL_WINDOW_FULLSCREEN_DESKTOP;
 	}
 
+	// render without a window when asked to, the value optionally names the output file
+	const char* headless_env = getenv("STARCEILING_HEADLESS");
+	if (headless_env) {
+		bHeadless = true;
+		if (*headless_env != '\0' && strcmp(headless_env, "1") != 0) headless_output = headless_env;
+	}
+
 	// Initialize SDL
-	if (SDL_Init(SDL_INIT_EVERYTHING) != 0) {
+	if (!bHeadless && SDL_Init(SDL_INIT_EVERYTHING) != 0) {
+		// no display or GPU, fall back to rendering without a window
+		std::cout << "Failed to initialize SDL:" << SDL_GetError() << "\n";
+		std::cout << "Rendering headless to " << headless_output << "\n";
+		bHeadless = true;
+	}
+	if (bHeadless && SDL_Init(SDL_INIT_TIMER) != 0) {
 		// SDL failed. Output error message and exit
 		std::cout << "Failed to initialize SDL:" << SDL_GetError() << "\n";
 		return EXIT_FAILURE;
@@ -104,6 +168,10 @@ int main() {
 		std::cout << "Failed to load font '" << Environment::fontname << ".ttf': " << err << "\n";
 	}
 
+	if (bHeadless) {
+		return runHeadless();
+	}
+
 	// Create Window
 	Environment::window = SDL_CreateWindow("Test Window", SDL_WINDOWPOS_CENTERED, SDL_WINDOWPOS_CENTERED, 0, 0, SDL_WINDOW_FLAGS);
 	if (!Environment::window) {
@@ -115,6 +183,12 @@ int main() {
 	SDL_SetWindowMinimumSize(Environment::window, 100, 100);
 	SDL_GetWindowSize(Environment::window, &WINDOW_WIDTH, &WINDOW_HEIGHT);
 
+	// animation is paced to the display
+	SDL_DisplayMode display_mode;
+	if (SDL_GetCurrentDisplayMode(SDL_GetWindowDisplayIndex(Environment::window), &display_mode) == 0 && display_mode.refresh_rate > 0) {
+		display_refresh_rate = display_mode.refresh_rate;
+	}
+
 	// Create Renderer
 	Environment::renderer = SDL_CreateRenderer(Environment::window, SDL_WINDOW_INDEX, SDL_RENDERER_FLAGS);
 	if (!Environment::renderer) {
@@ -122,15 +196,32 @@ int main() {
 		return EXIT_FAILURE;
 	}
 
+	// software renderers are slow per primitive, so rasterize the stars on the CPU instead
+	SDL_RendererInfo renderer_info;
+	if (SDL_GetRendererInfo(Environment::renderer, &renderer_info) == 0 && (renderer_info.flags & SDL_RENDERER_SOFTWARE) != 0) {
+		bUseSoftwareRasterizer = true;
+	}
+	if (bUseSoftwareRasterizer) {
+		std::cout << "Using software star rasterizer.\n";
+		software_rasterizer = std::make_unique<Rasterizer>();
+	}
+	Environment::backend = std::make_unique<SdlBackend>();
+
 	// set star texture rectangle
-	calculateCeilingSize();
+	updateCeilingLayout();
 
 	std::cout << "Ceiling Size: {" << ceiling_size.x << ", " << ceiling_size.y << "}\n";
 	std::cout << "Ceiling Offset: {" << ceiling_offset.x << ", " << ceiling_offset.y << "}\n";
-	star_rect = SDL_Rect{ ceiling_offset.x, ceiling_offset.y, ceiling_size.x, ceiling_size.y };
 
-	SDL_SetRenderDrawColor(Environment::renderer, 0, 0, 0, 255);
-	SDL_SetRenderDrawBlendMode(Environment::renderer, SDL_BLENDMODE_BLEND);
+	// cached UI layer
+	info_widget = std::make_unique<Widget>(info_pos, info_size);
+	button_widget = std::make_unique<Widget>(button_pos, button_size + Vector2<int>{ 1, 1 });
+	grid_widget = std::make_unique<Widget>(ceiling_offset, ceiling_size);
+
+	resetRenderState();
+	setRenderTarget(NULL);
+	setDrawColor(RGBA{ 0, 0, 0, SDL_ALPHA_OPAQUE });
+	setDrawBlendMode(SDL_BLENDMODE_BLEND);
 	SDL_RenderClear(Environment::renderer); // initialize backbuffer
 	bIsRunning = true; // everything was set up successfully
 
@@ -142,18 +233,46 @@ int main() {
 
 	// load stars
 	readCSV("star_data_large.csv", true);
+	populateConstellations();
 
 	bLoadingStars = false;
 	
 	correctStarRotation(-M_PI_2);
+	bStarsChanged = true;
 	
+	Uint64 last_update = SDL_GetPerformanceCounter();
 	while (bIsRunning) {
+		Uint64 frame_start = SDL_GetPerformanceCounter();
 		handleEvents();
+
+		// time step for animation, not counting time spent idle
+		Uint64 now = SDL_GetPerformanceCounter();
+		frame_delta = std::min(static_cast<float>((now - last_update) / static_cast<double>(SDL_GetPerformanceFrequency())), MAX_FRAME_DELTA);
+		last_update = now;
+
 		handleUserInput();
 		update();
-		render();
+		const bool bRendered = bRedraw || bStarsChanged;
+		if (bRendered) {
+			render();
+		}
+		paceFrame(frame_start, bRendered);
 	}
 
+	// templates, prints, hole lists and framings still in progress use the thread pool
+	waitForGenerate();
+	waitForExportPrint();
+	waitForExportHoles();
+	waitForFraming();
+
+	// widget, sprite and segment textures belong to the renderer, so release them first
+	destroyStarSprites();
+	info_widget.reset();
+	button_widget.reset();
+	grid_widget.reset();
+	segments.clear();
+	Environment::backend.reset();
+
 	// frees memory associated with renderer and window
 	SDL_DestroyRenderer(Environment::renderer);
 	SDL_DestroyWindow(Environment::window);
@@ -174,147 +293,414 @@ int main() {
 	IMG_Quit();
 	SDL_Quit();
 
+	software_rasterizer.reset();
+	thread_pool.reset();
+
 	return 0;
 }
 
+/*
+	Renders the ceiling once into an in-memory framebuffer and saves it, for machines without a display.
+	SDL is only initialised for its timer.
+*/
+int runHeadless() {
+	calculateCeilingSize();
+	rebuildSegments();
+	std::cout << "Ceiling Size: {" << ceiling_size.x << ", " << ceiling_size.y << "}\n";
+
+	auto framebuffer = std::make_unique<FramebufferBackend>(star_layer_size);
+	FramebufferBackend* output = framebuffer.get();
+	Environment::backend = std::move(framebuffer);
+
+	// load stars
+	readCSV("star_data_large.csv", true);
+	populateConstellations();
+	bLoadingStars = false;
+	correctStarRotation(-M_PI_2);
+
+	// the framebuffer is the star layer, so the ceiling starts at the margin
+	drawStars(RenderQuality::FULL);
+	drawCeilingGrid(star_layer_margin);
+
+	const bool bSaved = output->Save(headless_output, SDL_Rect{ star_layer_margin.x, star_layer_margin.y, ceiling_size.x, ceiling_size.y });
+	if (bSaved) {
+		std::cout << "Saved " << headless_output << "\n";
+	}
+
+	// print resolution export, the value optionally names the output file
+	const char* print_env = getenv("STARCEILING_PRINT");
+	if (print_env) {
+		if (*print_env != '\0' && strcmp(print_env, "1") != 0) export_filename = print_env;
+		exportPrint(export_filename);
+	}
+
+	Environment::backend.reset();
+
+	// close fonts
+	TTF_CloseFont(Environment::font_small);
+	TTF_CloseFont(Environment::font_medium);
+	TTF_CloseFont(Environment::font_large);
+	TTF_CloseFont(Environment::font_title);
+	TTF_Quit();
+	SDL_Quit();
+
+	thread_pool.reset();
+
+	return bSaved ? 0 : EXIT_FAILURE;
+}
+
 void update() {
+	updateView(frame_delta);
+	updateGenerate();
+	updateExportPrint();
+	updateExportHoles();
+	updateFraming();
+
+	// refine the draft once input has been idle for a moment
+	if (bRefinePending && !isViewMoving() && SDL_GetTicks() - last_interaction_ticks >= REFINE_DELAY_MS) {
+		bRefinePending = false;
+		bStarsChanged = true;
+	}
+
 	// rotate stars
 	if (EARTH_ROTATION_RATE > 0 && bRotateStars) {
 		increment_time(EARTH_ROTATION_RATE);
-		auto universe_i = universe.begin();
-		while (universe_i != universe.end())
-		{
-			// get value from star
-			auto& star = universe_i->second;
-
-			if (star) {
-				// rotate around Y axis by time of day, then rotate about X axis by latitude
-				Vector3 new_loc = star->GetAbsoluteLocation();
-				star->Rotate_Y(new_loc, earth_rotation);
-				star->Rotate_X(latitude);
-				star->UpdateTransforms();
-			}
+		transformStars();
+	}
+}
 
-			universe_i++;
-		}
+void updateInfo() {
+	if (!info_widget) return;
+
+	// only rasterize the text when the counts change
+	size_t state = hashCombine(hashCombine(hashCombine(0, num_stars_large), num_stars_medium), num_stars_small);
+	if (info_widget->NeedsUpdate(state) && info_widget->BeginUpdate()) {
+		int text_x = 0;
+		int text_y = 0;
+		text_x += renderText("Large:", eFontSize::SMALL, text_x, text_y, false).x + 10;
+		text_x += renderText(std::to_string(num_stars_large), eFontSize::SMALL, text_x, text_y, false).x + 4;
+		text_x += renderText("/", eFontSize::SMALL, text_x, text_y, false).x + 4;
+		text_x += renderText(std::to_string(max_stars_large), eFontSize::SMALL, text_x, text_y, false).x;
+
+		text_x = 0;
+		text_y += 20;
+		text_x += renderText("Medium:", eFontSize::SMALL, text_x, text_y, false).x + 10;
+		text_x += renderText(std::to_string(num_stars_medium), eFontSize::SMALL, text_x, text_y, false).x + 4;
+		text_x += renderText("/", eFontSize::SMALL, text_x, text_y, false).x + 4;
+		text_x += renderText(std::to_string(max_stars_medium), eFontSize::SMALL, text_x, text_y, false).x;
+
+		text_x = 0;
+		text_y += 20;
+		text_x += renderText("Small:", eFontSize::SMALL, text_x, text_y, false).x + 10;
+		text_x += renderText(std::to_string(num_stars_small), eFontSize::SMALL, text_x, text_y, false).x + 4;
+		text_x += renderText("/", eFontSize::SMALL, text_x, text_y, false).x + 4;
+		text_x += renderText(std::to_string(max_stars_small), eFontSize::SMALL, text_x, text_y, false).x;
+
+		info_widget->EndUpdate();
+	}
 
-		bStarsChanged = true;
+}
+
+void updateGenerateButton() {
+	if (!button_widget) return;
+
+	const int progress = bGenerating ? static_cast<int>(getGenerateProgress() * button_size.x) : -1;
+	if (button_widget->NeedsUpdate(hashCombine(hashCombine(0, bIsCursorOverButton), progress)) && button_widget->BeginUpdate()) {
+		const Vector2<int> origin = { 0, 0 };
+		renderFillRect(origin, button_size, (bIsCursorOverButton ? button_bg_hover : button_bg));
+
+		// progress bar while the templates are generated
+		if (progress > 0) {
+			renderFillRect(origin, Vector2<int>{ progress, button_size.y }, button_bg_hover);
+		}
+		renderLine(origin, Vector2{ button_size.x, 0 }, button_border);
+		renderLine(Vector2{ 0, button_size.y }, button_size, button_border);
+		renderLine(origin, Vector2{ 0, button_size.y }, button_border);
+		renderLine(Vector2{ button_size.x, 0 }, button_size, button_border);
+		renderText(bGenerating ? "GENERATING" : "GENERATE", eFontSize::SMALL, button_size.x / 2, 6, true);
+		button_widget->EndUpdate();
 	}
+
 }
 
-void renderInfo() {
-	int text_x = 20;
-	int text_y = 20;
-	text_x += renderText("Large:", eFontSize::SMALL, text_x, text_y, false).x + 10;
-	text_x += renderText(std::to_string(num_stars_large), eFontSize::SMALL, text_x, text_y, false).x + 4;
-	text_x += renderText("/", eFontSize::SMALL, text_x, text_y, false).x + 4;
-	text_x += renderText(std::to_string(max_stars_large), eFontSize::SMALL, text_x, text_y, false).x;
-
-	text_x = 20;
-	text_y += 20;
-	text_x += renderText("Medium:", eFontSize::SMALL, text_x, text_y, false).x + 10;
-	text_x += renderText(std::to_string(num_stars_medium), eFontSize::SMALL, text_x, text_y, false).x + 4;
-	text_x += renderText("/", eFontSize::SMALL, text_x, text_y, false).x + 4;
-	text_x += renderText(std::to_string(max_stars_medium), eFontSize::SMALL, text_x, text_y, false).x;
-
-	text_x = 20;
-	text_y += 20;
-	text_x += renderText("Small:", eFontSize::SMALL, text_x, text_y, false).x + 10;
-	text_x += renderText(std::to_string(num_stars_small), eFontSize::SMALL, text_x, text_y, false).x + 4;
-	text_x += renderText("/", eFontSize::SMALL, text_x, text_y, false).x + 4;
-	text_x += renderText(std::to_string(max_stars_small), eFontSize::SMALL, text_x, text_y, false).x;
+// Draws the ceiling border and segment lines with the ceiling's top left corner at origin
+void drawCeilingGrid(Vector2<int> origin) {
+	// draw border
+	renderRect(origin, ceiling_size, border_colour);
+
+	// draw outline and cut outs
+	const float px_per_mm = getScreenPixelsPerMM();
+	for (const auto& ring : ceiling_geometry.GetOutline()) {
+		for (size_t i = 0; i < ring.size(); i++) {
+			const Vector2<float>& a = ring[i];
+			const Vector2<float>& b = ring[(i + 1) % ring.size()];
+			renderLine(
+				Vector2<float>(origin.x + a.x * px_per_mm, origin.y + a.y * px_per_mm),
+				Vector2<float>(origin.x + b.x * px_per_mm, origin.y + b.y * px_per_mm),
+				border_colour);
+		}
+	}
+
+	// draw segments
+	const Vector2<float> panel = ceiling_geometry.GetPanelSizeMM() * getScreenPixelsPerMM();
+	const Vector2<int> panels = ceiling_geometry.GetPanelCount();
+	for (int i = 1; i < panels.x; i++) {
+		const int x = static_cast<int>(lroundf(i * panel.x));
+		renderLine(origin + Vector2{ x, 0 }, origin + Vector2{ x, ceiling_size.y }, grid_colour);
+	}
+	for (int i = 1; i < panels.y; i++) {
+		const int y = static_cast<int>(lroundf(i * panel.y));
+		renderLine(origin + Vector2{ 0, y }, origin + Vector2{ ceiling_size.x, y }, grid_colour);
+	}
 }
 
-void renderGenerateButton() {
-	renderFillRect(button_pos, button_size, (bIsCursorOverButton ? button_bg_hover : button_bg));
-	renderLine(button_pos, Vector2{ button_pos.x + button_size.x, button_pos.y }, button_border);
-	renderLine(Vector2{ button_pos.x, button_pos.y + button_size.y }, button_pos + button_size, button_border);
-	renderLine(button_pos, Vector2{ button_pos.x, button_pos.y + button_size.y }, button_border);
-	renderLine(Vector2{ button_pos.x + button_size.x, button_pos.y }, button_pos + button_size, button_border);
-	renderText("GENERATE", eFontSize::SMALL, button_pos.x + button_size.x / 2, button_pos.y + 6, true);
+void updateCeilingGrid() {
+	if (!grid_widget) return;
+
+	// the border and segment lines only change with the ceiling size and panel grid
+	grid_widget->SetPosition(ceiling_offset);
+	grid_widget->SetSize(ceiling_size);
+	const Vector2<float> panel = ceiling_geometry.GetPanelSizeMM() * getScreenPixelsPerMM();
+	size_t state = hashCombine(hashCombine(0, ceiling_size.x), ceiling_size.y);
+	state = hashCombine(hashCombine(state, lroundf(panel.x)), lroundf(panel.y));
+	state = hashCombine(state, ceiling_geometry.GetOutline().size());
+	if (grid_widget->NeedsUpdate(state) && grid_widget->BeginUpdate()) {
+		drawCeilingGrid(Vector2<int>{ 0, 0 });
+		grid_widget->EndUpdate();
+	}
+
 }
 
 // Render the Game
 void render() {
 	if (!bIsActive) return;
 
-	SDL_SetRenderDrawColor(Environment::renderer, 0, 0, 0, 255);
+	// offscreen passes first, so each target is bound once per frame
+	if (!bLoadingStars) {
+		if (bStarsChanged || !star_texture) {
+			drawStars(bRefinePending ? RenderQuality::DRAFT : RenderQuality::FULL);
+			bStarsChanged = false;
+		}
+
+		updateCeilingGrid();
+		updateInfo();
+		updateGenerateButton();
+	}
+
+	// window pass
+	setRenderTarget(NULL); // NULL: render to the window
+	setDrawColor(RGBA{ 0, 0, 0, SDL_ALPHA_OPAQUE });
 	SDL_RenderClear(Environment::renderer);
 
 	if (bLoadingStars) {
 		renderText("LOADING...", eFontSize::TITLE, WINDOW_WIDTH_HALF, WINDOW_HEIGHT_HALF - 30, true);
 	}
 	else {
-		drawStars();
+		// the cached layer, shifted and scaled to the current view and clipped to the ceiling
+		SDL_FRect layer_dest = getStarLayerDest();
+		layer_dest.x += star_rect.x;
+		layer_dest.y += star_rect.y;
+		SDL_RenderSetClipRect(Environment::renderer, &star_rect);
+		SDL_RenderCopyF(Environment::renderer, star_texture, NULL, &layer_dest);
+		SDL_RenderSetClipRect(Environment::renderer, NULL);
+
+		// composite the cached UI layer over the sky
+		for (Widget* widget : { grid_widget.get(), info_widget.get(), button_widget.get() }) {
+			if (widget) widget->Render();
+		}
+	}
+
+	SDL_RenderPresent(Environment::renderer);
+	bRedraw = false;
+}
+
+/*
+	Returns true while the view changes from frame to frame (panning or time-lapse), in which case frames are
+	paced to the display instead of waiting for events.
+*/
+bool isAnimating() {
+	return isViewMoving() || bRefinePending || bGenerating || isExportingHoles() || isFraming() || (EARTH_ROTATION_RATE > 0 && bRotateStars);
+}
 
-		// draw border
-		SDL_SetRenderTarget(Environment::renderer, star_texture);
-		renderRect(Vector2{ 0, 0 }, ceiling_size, RGBA{ 128, 128, 200, 128 });
+// true while panning, coasting after a pan, or easing towards the zoom target
+bool isViewMoving() {
+	return mouse_btn_left || zoom != zoom_target || pan_velocity.x != 0.f || pan_velocity.y != 0.f;
+}
 
-		// draw segments
-		for (int x = 0; x < ceiling_size.x; x += segment_size) {
-			renderLine(Vector2{ x, 0 }, Vector2{ x, ceiling_size.y }, RGB{ 100, 100, 160 });
+/*
+	Advances zoom and inertial pan animation. While the view moves the cached star layer is scaled and shifted
+	to match; stars are only re-selected at full quality once the view settles, or when the layer no longer
+	covers the ceiling.
+*/
+void updateView(float delta_seconds) {
+	bool bMoved = false;
+
+	// zoom eases towards its target in log space
+	if (zoom != zoom_target) {
+		const float log_target = log(zoom_target);
+		const float log_zoom = log(zoom) + (log_target - log(zoom)) * (1.f - exp(-delta_seconds / ZOOM_SMOOTHING));
+		zoom = (fabs(log_target - log_zoom) < 0.002f) ? zoom_target : exp(log_zoom);
+		bMoved = true;
+	}
+
+	// coast after the mouse is released
+	if (!mouse_btn_left && (pan_velocity.x != 0.f || pan_velocity.y != 0.f)) {
+		pan_position += pan_velocity * delta_seconds;
+		window_offset = Vector2<int>(static_cast<int>(lround(pan_position.x)), static_cast<int>(lround(pan_position.y)));
+
+		pan_velocity *= exp(-PAN_FRICTION * delta_seconds);
+		if (hypot(pan_velocity.x, pan_velocity.y) < PAN_STOP_SPEED) {
+			pan_velocity = Vector2<float>(0.f, 0.f);
 		}
-		for (int y = 0; y < ceiling_size.y; y += segment_size) {
-			renderLine(Vector2{ 0, y }, Vector2{ ceiling_size.x, y }, RGB{ 100, 100, 160 });
+		bMoved = true;
+	}
+
+	if (bMoved) {
+		markInteraction();
+
+		// draft redraw only when the cached layer no longer covers the ceiling
+		if (isViewMoving() && !starLayerCoversCeiling()) {
+			bStarsChanged = true;
+		}
+		else {
+			bRedraw = true;
 		}
+	}
+}
 
-		renderInfo();
-		renderGenerateButton();
+// the full quality selection is deferred until input has been idle for REFINE_DELAY_MS
+void markInteraction() {
+	last_interaction_ticks = SDL_GetTicks();
+	bRefinePending = true;
+}
 
+/*
+	Sleeps for the remainder of the frame when a frame cap applies. With vsync and no cap, presenting already
+	blocks until the display refreshes, but only when a frame was presented: frames that skipped rendering
+	while animating (e.g. generating, or waiting to refine) sleep for a refresh period instead.
+*/
+void paceFrame(Uint64 frame_start, bool bRendered) {
+	int frame_rate = frame_cap;
+	if ((present_mode == PresentMode::IMMEDIATE || !bRendered) && frame_rate <= 0) {
+		frame_rate = display_refresh_rate;
 	}
+	if (frame_rate <= 0) return;
 
-	SDL_RenderCopy(Environment::renderer, star_texture, NULL, &star_rect);
-	SDL_RenderPresent(Environment::renderer);
+	const double frame_time = 1.0 / frame_rate;
+	const double elapsed = (SDL_GetPerformanceCounter() - frame_start) / static_cast<double>(SDL_GetPerformanceFrequency());
+	if (elapsed < frame_time) {
+		SDL_Delay(static_cast<Uint32>((frame_time - elapsed) * 1000.0));
+	}
 }
 
 // handles any events that SDL noticed.
 void handleEvents() {
-	//the only event we'll check is the  SDL_QUIT event.
 	SDL_Event event;
+
+	// nothing to draw: block until something happens instead of spinning
+	bool bIdle = !bIsActive || (!bRedraw && !bStarsChanged && !isAnimating());
+	if (bIdle && SDL_WaitEventTimeout(&event, IDLE_TIMEOUT_MS)) {
+		handleEvent(event);
+	}
+
 	while (SDL_PollEvent(&event))
 	{
-		switch (event.type) {
-		case SDL_QUIT:
-			bIsRunning = false;
-			break;
-		case SDL_MOUSEWHEEL:
-			if (bIsCursorInSky) {
-				if (event.wheel.y < 0) {
-					// zoom in
-					zoom_steps = std::clamp(++zoom_steps, MIN_ZOOM, MAX_ZOOM);
-				}
-				else if (event.wheel.y > 0) {
-					// zoom out
-					zoom_steps = std::clamp(--zoom_steps, MIN_ZOOM, MAX_ZOOM);
-				}
+		handleEvent(event);
+	}
+}
 
-				updateZoom();
+void handleEvent(const SDL_Event& event) {
+	switch (event.type) {
+	case SDL_QUIT:
+		bIsRunning = false;
+		break;
+	case SDL_MOUSEBUTTONDOWN:
+		if (event.button.button == SDL_BUTTON_LEFT && bIsCursorOverButton) {
+			startGenerate();
+		}
+		bRedraw = true;
+		break;
+	case SDL_MOUSEMOTION:
+	case SDL_MOUSEBUTTONUP:
+		// hover and pan state may have changed
+		bRedraw = true;
+		break;
+	case SDL_MOUSEWHEEL:
+		if (bIsCursorInSky) {
+			if (event.wheel.y < 0) {
+				// zoom in
+				zoom_steps = std::clamp(static_cast<unsigned short>(zoom_steps + 1), MIN_ZOOM, MAX_ZOOM);
+			}
+			else if (event.wheel.y > 0) {
+				// zoom out
+				zoom_steps = std::clamp(static_cast<unsigned short>(zoom_steps - 1), MIN_ZOOM, MAX_ZOOM);
 			}
 
+			updateZoom();
+			markInteraction();
+		}
+
+		break;
+	case SDL_KEYDOWN:
+		if (event.key.keysym.sym == SDLK_p && event.key.repeat == 0) {
+			// print resolution export, written on the thread pool
+			startExportPrint(export_filename);
+			bRedraw = true;
+		}
+		else if (event.key.keysym.sym == SDLK_e && event.key.repeat == 0) {
+			// hole lists for CNC drilling, from a full selection of the current view
+			startExportHoles(HOLE_DIRECTORY);
+		}
+		else if (event.key.keysym.sym == SDLK_v && event.key.repeat == 0) {
+			// cycle the ceiling's surface: flat, barrel vault, dome
+			const ProjectionMode mode = projection_mode == ProjectionMode::FLAT ? ProjectionMode::BARREL
+				: projection_mode == ProjectionMode::BARREL ? ProjectionMode::DOME : ProjectionMode::FLAT;
+			setProjectionMode(mode, vault_radius);
+			std::cout << "Projection: " << (mode == ProjectionMode::FLAT ? "flat" : mode == ProjectionMode::BARREL ? "barrel" : "dome") << "\n";
+			markInteraction();
+		}
+		else if (event.key.keysym.sym == SDLK_f && event.key.repeat == 0) {
+			// search time, rotation, zoom and pan for the best framing of the sky and show it
+			frameSky();
+		}
+		else if (event.key.keysym.sym == SDLK_b && event.key.repeat == 0) {
+			// toggle spreading the fibers evenly over the segments
+			selection_mode = selection_mode == SelectionMode::BALANCED ? SelectionMode::GLOBAL : SelectionMode::BALANCED;
+			std::cout << "Star selection: " << (selection_mode == SelectionMode::BALANCED ? "balanced" : "global") << "\n";
+			bStarsChanged = true;
+			markInteraction();
+		}
+		break;
+	case SDL_WINDOWEVENT:
+		switch(event.window.event) {
+		case SDL_WINDOWEVENT_FOCUS_LOST:
+
 			break;
-		case SDL_WINDOWEVENT:
-			switch(event.window.event) {
-			case SDL_WINDOWEVENT_FOCUS_LOST:
-
-				break;
-			case SDL_WINDOWEVENT_FOCUS_GAINED:
-			case SDL_WINDOWEVENT_RESTORED:
-			case SDL_WINDOWEVENT_SHOWN:
-			//case SDL_WINDOWEVENT_EXPOSED:
-				bIsActive = true;
-				break;
-			case SDL_WINDOWEVENT_HIDDEN:
-			case SDL_WINDOWEVENT_MINIMIZED:
-				bIsActive = false;
-				break;
-			default:
-				break;
-			}
+		case SDL_WINDOWEVENT_FOCUS_GAINED:
+		case SDL_WINDOWEVENT_RESTORED:
+		case SDL_WINDOWEVENT_SHOWN:
+			bIsActive = true;
+			bRedraw = true;
+			break;
+		case SDL_WINDOWEVENT_EXPOSED:
+			bRedraw = true;
+			break;
+		case SDL_WINDOWEVENT_SIZE_CHANGED:
+			WINDOW_WIDTH = event.window.data1;
+			WINDOW_HEIGHT = event.window.data2;
+			updateScreenProperties();
+			updateCeilingLayout();
+			break;
+		case SDL_WINDOWEVENT_HIDDEN:
+		case SDL_WINDOWEVENT_MINIMIZED:
+			bIsActive = false;
 			break;
 		default:
 			break;
 		}
+		break;
+	default:
+		break;
 	}
 }
 
@@ -336,10 +722,30 @@ void handleUserInput()
 				// transition from button up to button down
 				window_pan_offset = window_offset;
 				cursor_pan_pos = cursor_pos;
+				pan_velocity = Vector2<float>(0.f, 0.f);
 			}
 
-			window_offset = window_pan_offset + cursor_pos - cursor_pan_pos;
-			bStarsChanged = true;
+			Vector2<int> new_offset = window_pan_offset + cursor_pos - cursor_pan_pos;
+
+			// smoothed drag speed, carried on as inertia after release
+			if (frame_delta > 0.f) {
+				const Vector2<float> drag_velocity = Vector2<float>(static_cast<float>(new_offset.x - window_offset.x), static_cast<float>(new_offset.y - window_offset.y)) / frame_delta;
+				pan_velocity = pan_velocity * 0.5f + drag_velocity * 0.5f;
+			}
+
+			if (new_offset.x != window_offset.x || new_offset.y != window_offset.y) {
+				window_offset = new_offset;
+				pan_position = Vector2<float>(static_cast<float>(new_offset.x), static_cast<float>(new_offset.y));
+				markInteraction();
+
+				// shift the cached layer until its margin runs out
+				if (starLayerCoversCeiling()) {
+					bRedraw = true;
+				}
+				else {
+					bStarsChanged = true;
+				}
+			}
 			mouse_btn_left = true;
 		}
 	}
@@ -348,7 +754,10 @@ void handleUserInput()
 		// left button up
 		if (mouse_btn_left) {
 			// transition from button down to button up
-
+			// panning finished: the stars are refined once the pan has coasted to a stop
+			if (hypot(pan_velocity.x, pan_velocity.y) < PAN_STOP_SPEED) {
+				pan_velocity = Vector2<float>(0.f, 0.f);
+			}
 		}
 
 		mouse_btn_left = false;
@@ -384,12 +793,231 @@ void handleUserInput()
 	}
 }
 
+// the framing search running on the thread pool, with its own copy of the ceiling it frames
+namespace FramingState {
+	struct Job {
+		FramingProblem problem{};
+		SurfaceProjection surface{};
+		CeilingMask mask{};
+		Uint64 start = 0;
+	};
+
+	static std::shared_ptr<Job> job{};
+	static std::future<std::vector<Framing>> result{};
+}
+
+/*
+	Starts searching for the framings that fit the constellations and the most starlight onto the ceiling;
+	updateFraming() prints the best and shows the first. Only the brightest stars and those of the
+	constellations are scored.
+*/
+void frameSky() {
+	if (FramingState::result.valid()) return;
+
+	auto job = std::make_shared<FramingState::Job>();
+	job->surface = surface_projection;
+	job->mask = ceiling_mask;
+
+	FramingProblem& problem = job->problem;
+	problem.budget = max_stars_small + max_stars_medium + max_stars_large;
+	problem.latitude = latitude;
+	problem.north = ceiling_geometry.GetNorth();
+	problem.coefficient = getScreenCoefficient() / zoom;
+	problem.ceiling_size = ceiling_size;
+	problem.max_zoom = FRAMING_MAX_ZOOM;
+	problem.surface = &job->surface;
+	problem.mask = &job->mask;
+
+	std::unordered_map<int, int> star_index;
+	auto addStar = [&](int id) {
+		auto found = star_index.find(id);
+		if (found != star_index.end()) return found->second;
+
+		auto star_result = universe.find(id);
+		if (star_result == universe.end() || !star_result->second) return -1;
+
+		const Star* star = star_result->second.get();
+		star_index[id] = static_cast<int>(problem.stars.size());
+		problem.stars.push_back(star->GetAbsoluteLocation());
+		problem.flux.push_back(powf(10.f, -0.4f * star->GetMagnitude()));
+		return star_index[id];
+	};
+
+	const size_t num_scored = std::min(stars_by_magnitude.size(), static_cast<size_t>(problem.budget * FRAMING_CANDIDATE_FACTOR));
+	for (size_t i = 0; i < num_scored; i++) {
+		addStar(stars_by_magnitude[i].first);
+	}
+
+	for (const auto& constellation : constellations) {
+		std::vector<int> members;
+		for (int edge = constellation.first_edge; edge < constellation.first_edge + constellation.num_edges; edge++) {
+			for (const Star* star : { constellation_edges[edge].first, constellation_edges[edge].second }) {
+				const int index = addStar(star->GetID());
+				if (index >= 0 && std::find(members.begin(), members.end(), index) == members.end()) members.push_back(index);
+			}
+		}
+		if (!members.empty()) problem.constellations.push_back(members);
+	}
+
+	job->start = SDL_GetPerformanceCounter();
+	FramingState::job = job;
+	FramingState::result = thread_pool->Submit([job] {
+		return searchFramings(job->problem, FRAMING_RESULTS, FRAMING_TIME_BUDGET_MS, thread_pool.get());
+	});
+}
+
+bool isFraming() {
+	return FramingState::result.valid();
+}
+
+// Call once per frame: prints and shows the framings once the search is done
+void updateFraming() {
+	if (!FramingState::result.valid() || FramingState::result.wait_for(std::chrono::seconds(0)) != std::future_status::ready) return;
+
+	const std::vector<Framing> framings = FramingState::result.get();
+	const FramingProblem& problem = FramingState::job->problem;
+	const double seconds = (SDL_GetPerformanceCounter() - FramingState::job->start) / static_cast<double>(SDL_GetPerformanceFrequency());
+	std::cout << "Framings (" << seconds << " s):\n";
+	for (const Framing& framing : framings) {
+		std::cout << "  time " << framing.earth_rotation * 24.f / _2PI << " h, rotation " << framing.sky_rotation * 180.f / M_PI
+			<< " deg, zoom " << framing.zoom << ", pan {" << framing.pan.x << ", " << framing.pan.y << "}: "
+			<< framing.num_constellations << "/" << problem.constellations.size() << " constellations, "
+			<< framing.flux * 100.f << "% flux\n";
+	}
+
+	FramingState::job.reset();
+
+	if (!framings.empty()) {
+		applyFraming(framings.front());
+		markInteraction();
+	}
+}
+
+void waitForFraming() {
+	if (FramingState::result.valid()) FramingState::result.get();
+	FramingState::job.reset();
+}
+
+/*
+	Loads the constellation stick figures once the stars are read, from CONSTELLATION_FILENAME or
+	CONSTELLATION_JSON_FILENAME if either is there, otherwise only the southern cross.
+*/
 void populateConstellations() {
-	// Add southern cross (Crux)
-	auto crux = std::vector<std::pair<int, int>>();
-	addStarsToConstellation(crux, 60530, 60893); // Add Alpha Crux and Gamma Crux
-	addStarsToConstellation(crux, 62239, 59565); // Add Beta Crux and Delta Crux
-	constellations.push_back(crux);
+	constellations.clear();
+	constellation_edges.clear();
+	if (loadConstellations(CONSTELLATION_FILENAME) || loadConstellationsJson(CONSTELLATION_JSON_FILENAME)) return;
+
+	std::cout << "Neither \"" << CONSTELLATION_FILENAME << "\" nor \"" << CONSTELLATION_JSON_FILENAME << "\" exists in "
+		<< std::filesystem::current_path() << ", only the southern cross is shown. See README.md for where to get them.\n";
+
+	// southern cross (Crux): Alpha to Gamma Crucis, Beta to Delta Crucis
+	addConstellation("Cru", { { 60718, 61084 }, { 62434, 59747 } });
+}
+
+/*
+	Reads stick figures in Stellarium's constellationship.fab format: one constellation per line, as its
+	abbreviation, the number of edges, then two HIP numbers per edge.
+*/
+bool loadConstellations(const std::string& filename) {
+	std::ifstream file(filename);
+	if (!file.good()) return false;
+
+	int num_missing = 0;
+	std::string line;
+	std::vector<std::pair<int, int>> hip_pairs;
+	while (getline(file, line)) {
+		std::stringstream str(line);
+		std::string abbreviation;
+		int num_edges = 0;
+		if (!(str >> abbreviation >> num_edges) || abbreviation[0] == '#') continue;
+
+		hip_pairs.clear();
+		int hip_a = 0;
+		int hip_b = 0;
+		for (int edge = 0; edge < num_edges && (str >> hip_a >> hip_b); edge++) {
+			hip_pairs.push_back({ hip_a, hip_b });
+		}
+		num_missing += addConstellation(abbreviation, hip_pairs);
+	}
+
+	std::cout << "Read " << constellations.size() << " constellations with " << constellation_edges.size() << " lines";
+	if (num_missing > 0) std::cout << ", " << num_missing << " lines have stars missing from the catalog";
+	std::cout << ".\n";
+	return true;
+}
+
+/*
+	Reads stick figures from a Stellarium sky culture's index.json, the format that replaced
+	constellationship.fab: every "CON ..." entry of "constellations" has "lines", each a polyline of HIP
+	numbers. Only those fields are picked out, without a full JSON parser. Entries that aren't HIP numbers
+	break the polyline.
+*/
+bool loadConstellationsJson(const std::string& filename) {
+	std::ifstream file(filename, std::ios::binary);
+	if (!file.good()) return false;
+
+	std::stringstream contents;
+	contents << file.rdbuf();
+	const std::string text = contents.str();
+
+	// the string value following key at or after from, and the position after it
+	auto findString = [&text](const char* key, size_t from, std::string& value) {
+		size_t at = text.find(key, from);
+		if (at == std::string::npos) return std::string::npos;
+		const size_t open = text.find('"', text.find(':', at));
+		const size_t close = open == std::string::npos ? std::string::npos : text.find('"', open + 1);
+		if (close == std::string::npos) return std::string::npos;
+		value = text.substr(open + 1, close - open - 1);
+		return close + 1;
+	};
+
+	size_t at = text.find("\"constellations\"");
+	if (at == std::string::npos) return false;
+
+	int num_missing = 0;
+	std::string id;
+	std::vector<std::pair<int, int>> hip_pairs;
+	while ((at = findString("\"id\"", at, id)) != std::string::npos) {
+		// asterisms and anything else that isn't a constellation are skipped
+		if (id.rfind("CON ", 0) != 0) continue;
+
+		const size_t next_id = text.find("\"id\"", at);
+		const size_t lines = text.find("\"lines\"", at);
+		if (lines == std::string::npos || lines > next_id) continue;
+
+		hip_pairs.clear();
+		int depth = 0;
+		int previous = 0;
+		for (size_t i = text.find('[', lines); i < text.size(); i++) {
+			const char c = text[i];
+			if (c == '[') {
+				depth++;
+				previous = 0;
+			}
+			else if (c == ']') {
+				if (--depth == 0) break;
+			}
+			else if (c == '"') {
+				i = text.find('"', i + 1);
+				if (i == std::string::npos) break;
+				previous = 0;
+			}
+			else if (depth == 2 && c >= '0' && c <= '9') {
+				int hip = 0;
+				const auto result = std::from_chars(text.data() + i, text.data() + text.size(), hip);
+				if (previous > 0) hip_pairs.push_back({ previous, hip });
+				previous = hip;
+				i = result.ptr - text.data() - 1;
+			}
+		}
+
+		num_missing += addConstellation(id.substr(id.find_last_of(' ') + 1), hip_pairs);
+	}
+
+	std::cout << "Read " << constellations.size() << " constellations with " << constellation_edges.size() << " lines from " << filename;
+	if (num_missing > 0) std::cout << ", " << num_missing << " lines have stars missing from the catalog";
+	std::cout << ".\n";
+	return !constellations.empty();
 }
 
 // Read CSV file into array
@@ -429,6 +1057,9 @@ void readCSV(std::string filename, bool has_header) {
 		// create a new star from values
 		auto star = std::unique_ptr<Star>(new Star());
 		star->SetID(std::stoi(getValueFromIndex(row, 0)));
+		star->SetHIP(getValueFromIndex(row, 1));
+		star->SetHD(getValueFromIndex(row, 2));
+		star->SetHR(getValueFromIndex(row, 3));
 		star->SetName(getValueFromIndex(row, 6));
 		star->SetMagnitude(getValueFromIndex(row, 13));
 		star->SetColourIndex(getValueFromIndex(row, 16));
@@ -442,7 +1073,9 @@ void readCSV(std::string filename, bool has_header) {
 		// move star into sky
 		if (star->GetMagnitude() < Star::MIN_MAGNITUDE) {
 			stars_by_magnitude.push_back(std::pair<int, float>( star->GetID(), star->GetMagnitude() ) );
-			universe.insert(std::pair<int, std::unique_ptr<Star>>( star->GetID(), std::move(star)) );
+			const int hip = star->GetHIP();
+			auto inserted = universe.insert(std::pair<int, std::unique_ptr<Star>>( star->GetID(), std::move(star)) );
+			if (hip > 0 && inserted.second) stars_by_hip[hip] = inserted.first->second.get();
 		}
 	}
 
@@ -455,4 +1088,6 @@ void readCSV(std::string filename, bool has_header) {
 	std::sort(stars_by_magnitude.begin(), stars_by_magnitude.end(), sortStarsByMagnitude);
 	std::cout << "done.\n";
 
+	projection_cache.Invalidate();
+
 }
\ No newline at end of file
@@ -5,13 +5,34 @@
 #include <vector>
 #include "types.h"
 
+#pragma warning(push, 0)
+#include "SDL.h"
+#pragma warning(pop)
+#undef main
+
 int main();
+int runHeadless();
 void handleEvents();
+void handleEvent(const SDL_Event& event);
+bool isAnimating();
+bool isViewMoving();
+void updateView(float delta_seconds);
+void markInteraction();
+void paceFrame(Uint64 frame_start, bool bRendered);
 void handleUserInput();
 void update();
-void renderInfo();
-void renderGenerateButton();
+void updateInfo();
+void updateGenerateButton();
+void drawCeilingGrid(Vector2<int> origin);
+void updateCeilingGrid();
 void render();
 void readCSV(std::string filename, bool has_header = true);
 void calculateCeilingSize();
-void populateConstellations();
\ No newline at end of file
+void updateCeilingLayout();
+void frameSky();
+bool isFraming();
+void updateFraming();
+void waitForFraming();
+void populateConstellations();
+bool loadConstellations(const std::string& filename);
+bool loadConstellationsJson(const std::string& filename);
\ No newline at end of file
@@ -6,6 +6,8 @@
 
 #include <typeinfo>
 #include <stdint.h>
+#include <string>
+#include <vector>
 #include <math.h>
 
 template <typename T>
@@ -284,4 +286,65 @@ enum class StarSize {
 	SMALL,
 	MEDIUM,
 	LARGE
-};
\ No newline at end of file
+};
+
+// a star chosen for display, in star layer pixels
+struct SelectedStar {
+	int id = -1;
+	Vector2<float> position{ 0.f, 0.f };
+	StarSize size = StarSize::NONE;
+	RGB colour{};
+	uint8_t brightness = 0;
+	bool bOnCeiling = true; // false for stars drawn only in the layer's margin
+};
+
+// a constellation's stick figure, its edges are a range of constellation_edges
+struct Constellation {
+	std::string abbreviation{};
+	int first_edge = 0;
+	int num_edges = 0;
+};
+
+// connected line strips drawn together, strip i runs over points [i ? ends[i - 1] : 0, ends[i])
+struct Polylines {
+	std::vector<Vector2<float>> points{};
+	std::vector<int> ends{};
+
+	void Clear() {
+		points.clear();
+		ends.clear();
+	}
+
+	// ends the strip being added to, a single point is dropped
+	void EndStrip() {
+		const int start = ends.empty() ? 0 : ends.back();
+		const int end = static_cast<int>(points.size());
+		if (end - start >= 2) ends.push_back(end);
+		else points.erase(points.begin() + start, points.end());
+	}
+};
+
+// star layer quality: DRAFT while the user interacts, FULL once input is idle
+enum class RenderQuality {
+	DRAFT,
+	FULL
+};
+
+// frame presentation
+enum class PresentMode {
+	IMMEDIATE,
+	VSYNC
+};
+
+// how the tier budgets are spread over the ceiling
+enum class SelectionMode {
+	GLOBAL,		// brightest first over the whole ceiling
+	BALANCED	// brightest first, with a quota per segment and an even fill for small stars
+};
+
+// shape of the surface the sky is projected onto
+enum class ProjectionMode {
+	FLAT,		// plane, sky laid out by angle from the zenith
+	BARREL,		// barrel vault, curving across the ceiling's Y axis
+	DOME		// shallow spherical dome
+};
@@ -11,6 +11,7 @@
 
 #include "utilities.h"
 #include "globals.h"
+#include "Framing.h"
 
 
 bool screencoordsInBounds(Vector2<int> screen_coords, float Z) {
@@ -18,7 +19,14 @@ bool screencoordsInBounds(Vector2<int> screen_coords, float Z) {
 	bool y_in_bounds = screen_coords.y > 0 && screen_coords.y < ceiling_size.y;
 	bool z_in_bounds = Z > 0.f;
 	//bool z_in_bounds = true;
-	return (x_in_bounds && y_in_bounds && z_in_bounds);
+	return (x_in_bounds && y_in_bounds && z_in_bounds && ceiling_mask.Contains(screen_coords.x, screen_coords.y));
+}
+
+// like screencoordsInBounds, but includes the star layer's margin around the ceiling
+bool screencoordsInLayer(Vector2<int> screen_coords, float Z) {
+	bool x_in_bounds = screen_coords.x > -star_layer_margin.x && screen_coords.x < ceiling_size.x + star_layer_margin.x;
+	bool y_in_bounds = screen_coords.y > -star_layer_margin.y && screen_coords.y < ceiling_size.y + star_layer_margin.y;
+	return (x_in_bounds && y_in_bounds && Z > 0.f);
 }
 
 RGB hsl_to_rgb(const HSL hsl) {
@@ -106,16 +114,71 @@ HSL rgb_to_hsl(const RGB rgb) {
 	return hsl;
 }
 
+// sets the zoom target for zoom_steps; the shown zoom eases towards it
 void updateZoom() {
-	zoom = exp(log_min_zoom + (log_max_zoom - log_min_zoom) * zoom_steps / (MAX_ZOOM - 1));
+	zoom_target = exp(log_min_zoom + (log_max_zoom - log_min_zoom) * zoom_steps / (MAX_ZOOM - 1));
+	bRedraw = true;
+}
+
+// pixels per normalized screen unit at the current zoom
+float getScreenCoefficient() {
+	return static_cast<float>(std::min(WINDOW_WIDTH, WINDOW_HEIGHT) * window_scale * zoom);
+}
+
+// normalized screen coordinates of a star on the ceiling: turned to its orientation and the sky rotation, then onto its surface
+Vector2<float> projectToCeiling(Vector2<float> coords_n) {
+	const Vector2<float> oriented = ceiling_geometry.Orient(coords_n);
+	return surface_projection.Map(Vector2<float>(
+		oriented.x * sky_rotation_cs.x - oriented.y * sky_rotation_cs.y,
+		oriented.x * sky_rotation_cs.y + oriented.y * sky_rotation_cs.x));
+}
+
+// turns the sky on the ceiling, every star is projected again
+void setSkyRotation(float angle) {
+	sky_rotation = angle;
+	sky_rotation_cs = Vector2<float>(cosf(angle), sinf(angle));
+	projection_cache.Invalidate();
+	bStarsChanged = true;
+}
+
+// shows a framing: the stars are turned to its time, and the view zoomed and panned to it at once
+void applyFraming(const Framing& framing) {
+	earth_rotation = framing.earth_rotation;
+	transformStars();
+	setSkyRotation(framing.sky_rotation);
+
+	zoom_steps = static_cast<unsigned short>(std::clamp(lround(log(framing.zoom) * (MAX_ZOOM - 1) / (log_max_zoom - log_min_zoom)),
+		static_cast<long>(MIN_ZOOM), static_cast<long>(MAX_ZOOM)));
+	zoom = zoom_target = framing.zoom;
+
+	pan_position = framing.pan * getScreenCoefficient();
+	pan_velocity = Vector2<float>(0.f, 0.f);
+	window_offset = Vector2<int>(static_cast<int>(lround(pan_position.x)), static_cast<int>(lround(pan_position.y)));
+	bStarsChanged = true;
+}
+
+// switches the surface the sky is projected onto, every star is projected again
+void setProjectionMode(ProjectionMode mode, float radius) {
+	projection_mode = mode;
+	vault_radius = radius;
+	surface_projection.Build(mode, radius, SURFACE_GRID_RESOLUTION);
+	projection_cache.Invalidate();
 	bStarsChanged = true;
 }
 
+// scale of the ceiling on screen
+float getScreenPixelsPerMM() {
+	return ceiling_size.x / ceiling_geometry.GetSizeMM().x;
+}
+
 Vector2<int> getScreenCoords(const float scalar, const Vector2<float>& coords_n) {
-	// TODO: update below to a global variable updated only once
-	int x_half = ceiling_size.x / 2;
-	int y_half = ceiling_size.y / 2;
-	return Vector2<int>(static_cast<int>(round(scalar * coords_n.x + x_half)), static_cast<int>(round(scalar * coords_n.y + y_half)));
+	const Vector2<float> coords = getScreenCoordsF(scalar, coords_n);
+	return Vector2<int>(static_cast<int>(round(coords.x)), static_cast<int>(round(coords.y)));
+}
+
+// sub-pixel screen coordinates
+Vector2<float> getScreenCoordsF(const float scalar, const Vector2<float>& coords_n) {
+	return Vector2<float>(scalar * coords_n.x + ceiling_half.x, scalar * coords_n.y + ceiling_half.y);
 }
 
 bool fequals_zero(const float& f) {
@@ -132,6 +195,29 @@ void resetStarCount() {
 	num_stars_small = 0;
 }
 
+// turns every star by earth_rotation about Y, then by latitude about X, from its absolute location
+void transformStars() {
+	auto universe_i = universe.begin();
+	while (universe_i != universe.end())
+	{
+		// get value from star
+		auto& star = universe_i->second;
+
+		if (star) {
+			// rotate around Y axis by time of day, then rotate about X axis by latitude
+			Vector3 new_loc = star->GetAbsoluteLocation();
+			star->Rotate_Y(new_loc, earth_rotation);
+			star->Rotate_X(latitude);
+			star->UpdateTransforms();
+		}
+
+		universe_i++;
+	}
+
+	projection_cache.Invalidate();
+	bStarsChanged = true;
+}
+
 void correctStarRotation(const double& angle) {
 	// rotate stars by 90 degrees
 	auto universe_i = universe.begin();
@@ -149,6 +235,8 @@ void correctStarRotation(const double& angle) {
 
 		universe_i++;
 	}
+
+	projection_cache.Invalidate();
 }
 
 void updateScreenProperties() {
@@ -157,20 +245,136 @@ void updateScreenProperties() {
 }
 
 void clearSegments() {
-	for (auto& it : segments) {
-		it.second->ClearStars();
+	for (auto& segment : segments) {
+		segment.ClearStars();
+	}
+}
+
+/*
+	Adds a stick figure from pairs of HIP numbers, resolving them to stars. Edges with a star missing from
+	the catalog are left out; returns their number.
+*/
+int addConstellation(const std::string& abbreviation, const std::vector<std::pair<int, int>>& hip_pairs) {
+	Constellation constellation;
+	constellation.abbreviation = abbreviation;
+	constellation.first_edge = static_cast<int>(constellation_edges.size());
+
+	int num_missing = 0;
+	for (const auto& hip_pair : hip_pairs) {
+		auto star_a = stars_by_hip.find(hip_pair.first);
+		auto star_b = stars_by_hip.find(hip_pair.second);
+		if (star_a == stars_by_hip.end() || star_b == stars_by_hip.end()) {
+			num_missing++;
+			continue;
+		}
+		constellation_edges.push_back({ star_a->second, star_b->second });
+	}
+
+	constellation.num_edges = static_cast<int>(constellation_edges.size()) - constellation.first_edge;
+	if (constellation.num_edges > 0) constellations.push_back(constellation);
+	return num_missing;
+}
+
+// one empty segment per panel of ceiling_geometry
+void rebuildSegments() {
+	const Vector2<int> panels = ceiling_geometry.GetPanelCount();
+	segments.clear();
+	segments.reserve(ceiling_geometry.GetNumPanels());
+	for (int index = 0; index < ceiling_geometry.GetNumPanels(); index++) {
+		segments.emplace_back(index + 1, Vector2<int>{ index % panels.x + 1, index / panels.x + 1 },
+			ceiling_geometry.GetPanelOrigin(index), ceiling_geometry.GetPanelSize(index));
+	}
+}
+
+// index (segment ID - 1) of the segment containing the point, points off the ceiling use the nearest
+int getSegmentIndex(Vector2<float> ceiling_coords) {
+	return ceiling_geometry.GetPanelIndex(ceiling_coords / getScreenPixelsPerMM());
+}
+
+/*
+	Sorts the selected stars on the ceiling into their segments with one counting pass, storing each star's
+	position within its segment. Stars keep their magnitude order within a segment. Segments whose hole list
+	comes out the same are left untouched; returns the number of segments that changed.
+*/
+int binStarsIntoSegments(const std::vector<SelectedStar>& stars) {
+	const int num_segments = static_cast<int>(segments.size());
+	if (num_segments <= 0 || ceiling_size.x <= 0 || ceiling_size.y <= 0) return 0;
+
+	const float px_per_mm = getScreenPixelsPerMM();
+
+	// count the stars per segment
+	std::vector<int> star_segment(stars.size(), -1);
+	std::vector<int> starts(num_segments + 1, 0);
+	for (size_t i = 0; i < stars.size(); i++) {
+		if (!stars[i].bOnCeiling) continue;
+
+		star_segment[i] = getSegmentIndex(stars[i].position - star_layer_margin);
+		starts[star_segment[i] + 1]++;
+	}
+
+	for (int segment = 0; segment < num_segments; segment++) {
+		starts[segment + 1] += starts[segment];
+	}
+
+	// place each star in its segment's range
+	std::vector<int> order(starts[num_segments]);
+	std::vector<int> next(starts.begin(), starts.end() - 1);
+	for (size_t i = 0; i < stars.size(); i++) {
+		if (star_segment[i] >= 0) {
+			order[next[star_segment[i]]++] = static_cast<int>(i);
+		}
 	}
+
+	int num_changed = 0;
+	std::vector<Segment::StarData> segment_stars;
+	for (int segment = 0; segment < num_segments; segment++) {
+		Segment& target = segments[segment];
+		const Vector2<float> origin = target.GetOriginMM() * px_per_mm;
+		const Vector2<float> size = target.GetSizeMM() * px_per_mm;
+		segment_stars.clear();
+		for (int k = starts[segment]; k < starts[segment + 1]; k++) {
+			const SelectedStar& star = stars[order[k]];
+			const Vector2<float> local = star.position - star_layer_margin - origin;
+			segment_stars.push_back(Segment::StarData{ star.id, Vector2<float>(
+				std::clamp(local.x / size.x, 0.f, 1.f),
+				std::clamp(local.y / size.y, 0.f, 1.f)),
+				star.size });
+		}
+
+		if (target.SetStars(segment_stars)) num_changed++;
+	}
+
+	return num_changed;
 }
 
-void updateSegment(int id, Vector2<float> screen_coords, StarSize size) {
-	// get x and y coords of the segment
-	int segment_x = static_cast<int> (std::clamp(screen_coords.x * static_cast<float>(ceiling_x), 0.f, static_cast<float>(ceiling_x)));
-	int segment_y = static_cast<int> (std::clamp(screen_coords.y * static_cast<float>(ceiling_y), 0.f, static_cast<float>(ceiling_y)));
-	int segment_id = segment_y * ceiling_x + segment_x + 1;
+/*
+	Clips the line to the rectangle [min, max] (Liang-Barsky), moving its end points onto the edges.
+	Returns false if no part of the line is inside.
+*/
+bool clipLine(Vector2<float>& start, Vector2<float>& end, const Vector2<float>& min, const Vector2<float>& max) {
+	const float dx = end.x - start.x;
+	const float dy = end.y - start.y;
+	const float p[4] = { -dx, dx, -dy, dy };
+	const float q[4] = { start.x - min.x, max.x - start.x, start.y - min.y, max.y - start.y };
+
+	float t_enter = 0.f;
+	float t_exit = 1.f;
+	for (int i = 0; i < 4; i++) {
+		if (fequals_zero(p[i])) {
+			// parallel to this edge
+			if (q[i] < 0.f) return false;
+			continue;
+		}
 
-	// get x and y coords within the segment
-	float x = fmod(screen_coords.x, 1.f / ceiling_x);
-	float y = fmod(screen_coords.y, 1.f / ceiling_y);
+		const float t = q[i] / p[i];
+		if (p[i] < 0.f) t_enter = std::max(t_enter, t);
+		else t_exit = std::min(t_exit, t);
 
+		if (t_enter > t_exit) return false;
+	}
 
-}
\ No newline at end of file
+	const Vector2<float> origin = start;
+	start = Vector2<float>(origin.x + t_enter * dx, origin.y + t_enter * dy);
+	end = Vector2<float>(origin.x + t_exit * dx, origin.y + t_exit * dy);
+	return true;
+}
@@ -2,12 +2,11 @@
 
 #include <string>
 #include <vector>
+#include <functional>
 #include "Star.h"
 #include "types.h"
 
-static void addStarsToConstellation(std::vector<std::pair<int, int>>& constellation, const int star_a, const int star_b) {
-	constellation.push_back(std::pair<int, int>(star_a, star_b));
-}
+struct Framing;
 
 inline std::string& ltrim(std::string& s) {
 	s.erase(s.begin(), std::find_if(s.begin(), s.end(), [](int c) { return !std::isspace(c); }));
@@ -31,16 +30,35 @@ inline std::string getValueFromIndex(std::vector<std::string>& v, const unsigned
 	return (index >= v.size()) ? "" : trim(v[index]);
 }
 
+// combine the hash of value into seed, used for change detection of cached state
+template <typename T>
+inline size_t hashCombine(size_t seed, const T& value) {
+	return seed ^ (std::hash<T>{}(value) + 0x9e3779b9 + (seed << 6) + (seed >> 2));
+}
+
 bool screencoordsInBounds(Vector2<int> screen_coords, float Z);
+bool screencoordsInLayer(Vector2<int> screen_coords, float Z);
 RGB hsl_to_rgb(const HSL hsl);
 HSL rgb_to_hsl(const RGB rgb);
 void updateZoom();
+float getScreenCoefficient();
+Vector2<float> projectToCeiling(Vector2<float> coords_n);
+void setProjectionMode(ProjectionMode mode, float radius);
+void setSkyRotation(float angle);
+void applyFraming(const Framing& framing);
+float getScreenPixelsPerMM();
 Vector2<int> getScreenCoords(const float scalar, const Vector2<float>& coords_n);
+Vector2<float> getScreenCoordsF(const float scalar, const Vector2<float>& coords_n);
 bool fequals_zero(const float& f);
 void increment_time(const float delta_seconds);
 void resetStarCount();
 inline bool sortStarsByMagnitude(const std::pair<int, float>& a, const std::pair<int, float>& b) { return (a.second < b.second); }
+void transformStars();
 void correctStarRotation(const double& angle);
 void updateScreenProperties();
-void updateSegment(int id, Vector2<float> screen_coords, StarSize size);
-void clearSegments();
\ No newline at end of file
+int getSegmentIndex(Vector2<float> ceiling_coords);
+int binStarsIntoSegments(const std::vector<SelectedStar>& stars);
+void clearSegments();
+int addConstellation(const std::string& abbreviation, const std::vector<std::pair<int, int>>& hip_pairs);
+void rebuildSegments();
+bool clipLine(Vector2<float>& start, Vector2<float>& end, const Vector2<float>& min, const Vector2<float>& max);
\ No newline at end of file